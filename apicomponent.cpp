@@ -1,10 +1,19 @@
 #include "apicomponent.h"
+#include "playlistingestor.h"
+#include "resourcemonitor.h"
 
-#include <QDomDocument>
+#include <QFutureWatcher>
+#include <QNetworkAccessManager>
 
-ApiComponent::ApiComponent(QObject *parent) : QObject(parent)
+static const QString API_HOST = "api.vk.com";
+
+ApiComponent::ApiComponent(QObject *parent) : QObject(parent),
+    networkManager_(new MonitoredNetworkAccessManager(this)), scheduler_(new ApiRequestScheduler(networkManager_, this)),
+    ingestor_(new PlaylistIngestor(this)), baseUrl_("https://" + API_HOST)
 {
     initializeGenresMap();
+
+    connect(ingestor_, &PlaylistIngestor::tracksReady, this, &ApiComponent::playlistReceived);
 }
 
 void ApiComponent::setOAuthTokens(const ApiComponent::OAuthTokensMap &tokens)
@@ -12,6 +21,17 @@ void ApiComponent::setOAuthTokens(const ApiComponent::OAuthTokensMap &tokens)
     tokens_ = tokens;
 }
 
+void ApiComponent::setBaseUrl(const QUrl &url)
+{
+    Q_ASSERT(url.isValid());
+    baseUrl_ = url;
+}
+
+QUrl ApiComponent::baseUrl() const
+{
+    return baseUrl_;
+}
+
 const ApiComponent::OAuthTokensMap& ApiComponent::tokens() const
 {
     return tokens_;
@@ -22,6 +42,20 @@ const ApiComponent::GenresMap &ApiComponent::genres() const
     return genres_;
 }
 
+ApiRequestScheduler *ApiComponent::scheduler() const
+{
+    return scheduler_;
+}
+
+void ApiComponent::preconnect()
+{
+    //! Pay DNS, TCP and TLS setup while the user is still busy signing in
+    if (baseUrl_.scheme() == "https")
+        networkManager_->connectToHostEncrypted(baseUrl_.host(), baseUrl_.port(443));
+    else
+        networkManager_->connectToHost(baseUrl_.host(), baseUrl_.port(80));
+}
+
 void ApiComponent::getTokensFromUrl(const QUrl& url)
 {
     QString const urlString = url.toString();
@@ -42,44 +76,10 @@ void ApiComponent::getTokensFromUrl(const QUrl& url)
         tokens_[ExpiresIn] = urlString.mid(s_expires_in, e_expires_in - s_expires_in - 1);
         tokens_[UserId] = urlString.mid(s_userid, e_userid);
 
-        emit authorizeFinished(true, QString());
-    }
-}
-
-void ApiComponent::getPlaylistFromReply(QNetworkReply *reply)
-{
-    QDomDocument domDocument;
-    domDocument.setContent(reply->readAll());
-
-    QDomElement responseElement = domDocument.firstChildElement(); //! <response list = true>
-    QDomNode itemNode = responseElement.firstChildElement(); //! <audio>
-
-    Playlist playlist;
-
-    while(!itemNode.isNull())
-    {
-        PlaylistItem data;
-        QString const artist = itemNode.toElement().elementsByTagName("artist").item(0).toElement().text();
-        QString const title = itemNode.toElement().elementsByTagName("title").item(0).toElement().text();
-        QString const duration = itemNode.toElement().elementsByTagName("duration").item(0).toElement().text();
-        QString const url = itemNode.toElement().elementsByTagName("url").item(0).toElement().text();
-
-        if (!artist.isEmpty() && !title.isEmpty() && !duration.isEmpty() && !url.isEmpty())
-        {
-            data[Artist] = artist;
-            data[Title] = title;
-            data[Duration] = duration;
-            data[Url] = url;
+        preconnect();
 
-            playlist.push_back(data);
-        }
-
-        itemNode = itemNode.nextSibling();
+        emit authorizeFinished(true, QString());
     }
-
-    reply->deleteLater();
-
-    emit playlistReceived(playlist);
 }
 
 void ApiComponent::initializeGenresMap()
@@ -107,41 +107,90 @@ void ApiComponent::initializeGenresMap()
     genres_["Other"] = Other;
 }
 
-void ApiComponent::sendPlaylistRequest(const QString &request)
+void ApiComponent::sendPlaylistRequest(const QString &request, bool collapseDuplicates)
+{
+    scheduler_->enqueue(QUrl(request), [this, collapseDuplicates](const QByteArray& reply)
+    {
+        ingestor_->ingest(reply, collapseDuplicates);
+    });
+}
+
+void ApiComponent::readTracks(const QByteArray &reply, const std::function<void(const PlaylistModel::Tracks&)> &deliver)
 {
-    QNetworkAccessManager * networkManager = new QNetworkAccessManager(this);
-    connect(networkManager, &QNetworkAccessManager::finished, this, &ApiComponent::getPlaylistFromReply);
-    QNetworkRequest networkRequest(request);
+    //! Not the ingestor's watcher: a listing that arrives meanwhile must not drop these
+    QFutureWatcher<PlaylistModel::Tracks> *watcher = new QFutureWatcher<PlaylistModel::Tracks>(this);
+    connect(watcher, &QFutureWatcher<PlaylistModel::Tracks>::finished, this, [watcher, deliver]()
+    {
+        deliver(watcher->result());
+        watcher->deleteLater();
+    });
 
-    QNetworkReply *reply = networkManager->get(networkRequest);
+    watcher->setFuture(ingestor_->read(reply));
+}
+
+QString ApiComponent::methodUrl(const QString &method) const
+{
+    return baseUrl_.toString(QUrl::StripTrailingSlash) + "/method/" + method + ".xml";
 }
 
 void ApiComponent::requestAuthUserPlaylist()
 {
     Q_ASSERT(tokens_.contains(UserId));
 
-    sendPlaylistRequest("https://api.vk.com/method/audio.get.xml?uid=" + tokens_[UserId]
+    sendPlaylistRequest(methodUrl("audio.get") + "?uid=" + tokens_[UserId]
                         + "&access_token=" + tokens_[AccessToken]);
 
 }
 
 void ApiComponent::requestSuggestedPlaylist()
 {
-    sendPlaylistRequest("https://api.vk.com/method/audio.getRecommendations.xml?uid=" +
+    sendPlaylistRequest(methodUrl("audio.getRecommendations") + "?uid=" +
                         tokens_[UserId] + "&access_token=" + tokens_[AccessToken] + "&count=500");
 }
 
 void ApiComponent::requestPopularPlaylistByGenre(const QString &genre)
 {
-    sendPlaylistRequest("https://api.vk.com/method/audio.getPopular.xml?uid=" +
+    sendPlaylistRequest(methodUrl("audio.getPopular") + "?uid=" +
                         tokens_[UserId] + "&access_token=" + tokens_[AccessToken] +
-                        + "&genre_id=" + QString::number(genres_[genre]) + "&count=500");
+                        + "&genre_id=" + QString::number(genres_[genre]) + "&count=500", true);
 }
 
 void ApiComponent::requestPlaylistBySearchQuery(const ApiComponent::SearchQuery &query)
 {
-    sendPlaylistRequest("https://api.vk.com/method/audio.search.xml?uid=" +
+    sendPlaylistRequest(methodUrl("audio.search") + "?uid=" +
                         tokens_[UserId] + "&access_token=" + tokens_[AccessToken] +
                         "&performer_only=" + QString::number(query.artist) +
-                        "&q=" + query.text + "&count=300");
+                        "&q=" + query.text + "&count=300", true);
+}
+
+void ApiComponent::requestTracksById(const QStringList &ids)
+{
+    if (ids.isEmpty())
+        return;
+
+    scheduler_->enqueue(QUrl(methodUrl("audio.getById") + "?audios=" + ids.join(',') +
+                             "&access_token=" + tokens_[AccessToken]), [this](const QByteArray& reply)
+    {
+        readTracks(reply, [this](const PlaylistModel::Tracks& tracks)
+        {
+            emit tracksResolved(tracks);
+        });
+    });
+}
+
+void ApiComponent::requestRecommendations(const QString &targetAudio, int offset, int count)
+{
+    QString request = methodUrl("audio.getRecommendations") + "?uid=" + tokens_[UserId] +
+            "&access_token=" + tokens_[AccessToken] + "&offset=" + QString::number(offset) +
+            "&count=" + QString::number(count);
+    if (!targetAudio.isEmpty())
+        request += "&target_audio=" + targetAudio;
+
+    scheduler_->enqueue(QUrl(request), [this, targetAudio](const QByteArray& reply)
+    {
+        readTracks(reply, [this, targetAudio](const PlaylistModel::Tracks& tracks)
+        {
+            emit recommendationsReceived(targetAudio, tracks);
+        });
+    });
 }
@@ -1,8 +1,16 @@
 #ifndef ApiComponent_H
 #define ApiComponent_H
 
+#include "apirequestscheduler.h"
+#include "playlistmodel.h"
+
 #include <QObject>
 #include <QNetworkReply>
+#include <QUrl>
+
+#include <functional>
+
+class PlaylistIngestor;
 
 class ApiComponent : public QObject
 {
@@ -25,14 +33,6 @@ public:
         QString text;
     };
 
-    enum PlaylistItemData
-    {
-        Artist,
-        Title,
-        Duration,
-        Url
-    };
-
     enum Genres
     {
         Rock = 1,
@@ -58,35 +58,51 @@ public:
         Other = 18
     };
 
-    typedef QMap<PlaylistItemData, QString> PlaylistItem;
-    typedef QList<PlaylistItem> Playlist;
     typedef QMap<QString, Genres> GenresMap;
 
     explicit ApiComponent(QObject *parent = 0);
 
     void setOAuthTokens(const OAuthTokensMap& tokens);
+    void setBaseUrl(const QUrl& url);
+    QUrl baseUrl() const;
     const OAuthTokensMap& tokens() const;
     const GenresMap& genres() const;
+    ApiRequestScheduler * scheduler() const;
 
 signals:
     void authorizeFinished(bool successfully, const QString& error);
-    void playlistReceived(const Playlist& playlist);
+    void playlistReceived(const PlaylistModel::Tracks& tracks);
+    void tracksResolved(const PlaylistModel::Tracks& tracks);
+    void recommendationsReceived(const QString& targetAudio, const PlaylistModel::Tracks& tracks);
 
 public slots:
+    void preconnect();
     void getTokensFromUrl(const QUrl& url);
     void requestAuthUserPlaylist();
     void requestSuggestedPlaylist();
     void requestPopularPlaylistByGenre(const QString& genre);
     void requestPlaylistBySearchQuery(const SearchQuery& query);
-
-private slots:
-    void getPlaylistFromReply(QNetworkReply *reply);
+    //! Fresh stream urls for owner_aid ids, answered by tracksResolved
+    void requestTracksById(const QStringList& ids);
+    //! Tracks similar to targetAudio, or to the user's taste when it is
+    //! empty; answered by recommendationsReceived
+    void requestRecommendations(const QString& targetAudio, int offset, int count);
 
 private:
     void initializeGenresMap();
 
-    void sendPlaylistRequest(const QString& request);
+    //! Search and popular lists carry the same song uploaded many times;
+    //! those are collapsed into one row before they reach a view
+    void sendPlaylistRequest(const QString& request, bool collapseDuplicates = false);
+    //! Parses reply off the GUI thread and hands the tracks to deliver
+    void readTracks(const QByteArray& reply, const std::function<void(const PlaylistModel::Tracks&)>& deliver);
+
+    QString methodUrl(const QString& method) const;
 
+    QNetworkAccessManager *networkManager_;
+    ApiRequestScheduler *scheduler_;
+    PlaylistIngestor *ingestor_;
+    QUrl baseUrl_;
     OAuthTokensMap tokens_;
     GenresMap genres_;
 };
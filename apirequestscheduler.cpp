@@ -0,0 +1,166 @@
+#include "apirequestscheduler.h"
+
+#include <QDomDocument>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTimer>
+#include <QtMath>
+
+static const int DEFAULT_REQUESTS_PER_SECOND = 3;
+static const int RATE_LIMIT_ERROR_CODE = 6;
+static const int HTTP_TOO_MANY_REQUESTS = 429;
+static const int BACKOFF_BASE_DELAY = 400;
+static const int BACKOFF_MAX_DELAY = 8000;
+static const int MAX_ATTEMPTS = 6;
+
+ApiRequestScheduler::ApiRequestScheduler(QNetworkAccessManager *networkManager, QObject *parent) : QObject(parent),
+    networkManager_(networkManager), timer_(new QTimer(this)), rate_(DEFAULT_REQUESTS_PER_SECOND),
+    tokens_(DEFAULT_REQUESTS_PER_SECOND), lastWaitTime_(0), random_(std::random_device()())
+{
+    Q_ASSERT(networkManager);
+
+    timer_->setSingleShot(true);
+    timer_->setTimerType(Qt::PreciseTimer);
+    connect(timer_, &QTimer::timeout, this, &ApiRequestScheduler::dispatch);
+
+    refillClock_.start();
+}
+
+void ApiRequestScheduler::setRate(int requestsPerSecond)
+{
+    Q_ASSERT(requestsPerSecond > 0);
+
+    refill();
+    rate_ = requestsPerSecond;
+    tokens_ = qMin<double>(tokens_, rate_);
+    scheduleDispatch();
+}
+
+int ApiRequestScheduler::rate() const
+{
+    return rate_;
+}
+
+void ApiRequestScheduler::enqueue(const QUrl &url, const ApiRequestScheduler::ReplyHandler &handler)
+{
+    PendingRequest request;
+    request.url = url;
+    request.handler = handler;
+    request.attempt = 0;
+    request.queued.start();
+
+    queue_.enqueue(request);
+    emit queueDepthChanged(queue_.size());
+
+    dispatch();
+}
+
+int ApiRequestScheduler::queueDepth() const
+{
+    return queue_.size();
+}
+
+qint64 ApiRequestScheduler::lastWaitTime() const
+{
+    return lastWaitTime_;
+}
+
+void ApiRequestScheduler::dispatch()
+{
+    refill();
+
+    bool dispatched = false;
+    while (tokens_ >= 1.0 && !queue_.isEmpty())
+    {
+        PendingRequest const request = queue_.dequeue();
+        tokens_ -= 1.0;
+        dispatched = true;
+
+        lastWaitTime_ = request.queued.elapsed();
+        emit requestDispatched(request.url, lastWaitTime_);
+
+        QNetworkReply *reply = networkManager_->get(QNetworkRequest(request.url));
+        inFlight_.insert(reply, request);
+        connect(reply, &QNetworkReply::finished, this, &ApiRequestScheduler::processReply);
+    }
+
+    if (dispatched)
+        emit queueDepthChanged(queue_.size());
+
+    scheduleDispatch();
+}
+
+void ApiRequestScheduler::processReply()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply || !inFlight_.contains(reply))
+        return;
+
+    PendingRequest const request = inFlight_.take(reply);
+    QByteArray const data = reply->readAll();
+    bool const rateLimited = isRateLimited(reply, data);
+    reply->deleteLater();
+
+    if (rateLimited && request.attempt + 1 < MAX_ATTEMPTS)
+    {
+        //! The server disagrees with our estimate, so spend the bucket; the
+        //! clock restarts too, or the time before the error refills it again
+        refillClock_.restart();
+        tokens_ = 0.0;
+        retry(request);
+        return;
+    }
+
+    request.handler(data);
+}
+
+void ApiRequestScheduler::refill()
+{
+    qint64 const elapsed = refillClock_.restart();
+    tokens_ = qMin<double>(rate_, tokens_ + elapsed * rate_ / 1000.0);
+}
+
+void ApiRequestScheduler::scheduleDispatch()
+{
+    if (queue_.isEmpty())
+    {
+        timer_->stop();
+        return;
+    }
+
+    int const delay = qMax(0, qCeil((1.0 - tokens_) * 1000.0 / rate_));
+    timer_->start(delay);
+}
+
+void ApiRequestScheduler::retry(PendingRequest request)
+{
+    ++request.attempt;
+
+    int const backoff = qMin(BACKOFF_MAX_DELAY, BACKOFF_BASE_DELAY << (request.attempt - 1));
+    std::uniform_int_distribution<int> jitter(backoff / 2, backoff);
+    int const delay = jitter(random_);
+
+    emit requestThrottled(request.url, request.attempt, delay);
+
+    QTimer::singleShot(delay, this, [this, request]()
+    {
+        queue_.prepend(request);
+        emit queueDepthChanged(queue_.size());
+        dispatch();
+    });
+}
+
+bool ApiRequestScheduler::isRateLimited(QNetworkReply *reply, const QByteArray &data)
+{
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == HTTP_TOO_MANY_REQUESTS)
+        return true;
+
+    if (!data.contains("<error>"))
+        return false;
+
+    QDomDocument domDocument;
+    domDocument.setContent(data);
+
+    QDomElement const errorElement = domDocument.firstChildElement("error");
+    return errorElement.firstChildElement("error_code").text().toInt() == RATE_LIMIT_ERROR_CODE;
+}
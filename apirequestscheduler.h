@@ -0,0 +1,72 @@
+#ifndef APIREQUESTSCHEDULER_H
+#define APIREQUESTSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QUrl>
+
+#include <functional>
+#include <random>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+
+//! Token bucket in front of the API: requests are queued and dispatched no
+//! faster than the per-token limit, rate-limit errors are retried with a
+//! jittered exponential backoff instead of reaching the reply handler
+class ApiRequestScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<void(const QByteArray&)> ReplyHandler;
+
+    explicit ApiRequestScheduler(QNetworkAccessManager *networkManager, QObject *parent = 0);
+
+    void setRate(int requestsPerSecond);
+    int rate() const;
+
+    void enqueue(const QUrl& url, const ReplyHandler& handler);
+
+    int queueDepth() const;
+    qint64 lastWaitTime() const;
+
+signals:
+    void queueDepthChanged(int depth);
+    void requestDispatched(const QUrl& url, qint64 waitTime);
+    void requestThrottled(const QUrl& url, int attempt, int delay);
+
+private slots:
+    void dispatch();
+    void processReply();
+
+private:
+    struct PendingRequest
+    {
+        QUrl url;
+        ReplyHandler handler;
+        int attempt;
+        QElapsedTimer queued;
+    };
+
+    void refill();
+    void scheduleDispatch();
+    void retry(PendingRequest request);
+
+    static bool isRateLimited(QNetworkReply *reply, const QByteArray& data);
+
+    QNetworkAccessManager *networkManager_;
+    QTimer *timer_;
+    QQueue<PendingRequest> queue_;
+    QHash<QNetworkReply*, PendingRequest> inFlight_;
+    int rate_;
+    double tokens_;
+    QElapsedTimer refillClock_;
+    qint64 lastWaitTime_;
+    std::mt19937 random_;
+};
+
+#endif // APIREQUESTSCHEDULER_H
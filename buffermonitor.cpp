@@ -0,0 +1,165 @@
+#include "buffermonitor.h"
+
+#include <QDebug>
+
+static const int RECENT_TRACK_COUNT = 50;
+static const double THROUGHPUT_WEIGHT = 0.3;
+//! Links this much faster than the stream bitrate never need a pre-roll
+static const double COMFORTABLE_HEADROOM = 1.5;
+static const int DEFAULT_BITRATE = 320;
+static const qint64 STALL_PENALTY = 1000;
+static const qint64 MAX_PRE_ROLL = 8000;
+static const int MIN_THROUGHPUT_SAMPLE_BYTES = 64 * 1024;
+
+BufferMonitor::BufferMonitor(QMediaPlayer *player, QObject *parent) : QObject(parent),
+    player_(player), tracking_(false), stalled_(false)
+{
+    Q_ASSERT(player);
+
+    connect(player_, &QMediaPlayer::currentMediaChanged, this, &BufferMonitor::trackMedia);
+    connect(player_, &QMediaPlayer::mediaStatusChanged, this, &BufferMonitor::trackMediaStatus);
+    connect(player_, &QMediaPlayer::positionChanged, this, &BufferMonitor::trackPosition);
+}
+
+BufferMonitor::~BufferMonitor()
+{
+}
+
+QList<BufferMonitor::TrackStats> BufferMonitor::recentTracks() const
+{
+    return recent_;
+}
+
+QHash<QString, BufferMonitor::HostStats> BufferMonitor::hosts() const
+{
+    return hosts_;
+}
+
+BufferMonitor::TrackStats BufferMonitor::currentTrack() const
+{
+    return current_;
+}
+
+qint64 BufferMonitor::preRollTime(const QString &host, int bitrate, int duration) const
+{
+    QHash<QString, HostStats>::const_iterator const stats = hosts_.constFind(host);
+    if (stats == hosts_.constEnd())
+        return 0;
+
+    qint64 preRoll = stats->recentStalls * STALL_PENALTY;
+
+    //! A link slower than the stream has to buffer the deficit up front
+    double const headroom = stats->throughput / (bitrate > 0 ? bitrate : DEFAULT_BITRATE);
+    if (stats->throughput > 0.0 && headroom < 1.0)
+        preRoll += qint64((1.0 - headroom) * duration * 1000);
+    else if (headroom >= COMFORTABLE_HEADROOM)
+        preRoll = 0;
+
+    return qMin(preRoll, MAX_PRE_ROLL);
+}
+
+void BufferMonitor::addThroughputSample(const QString &host, qint64 bytes, qint64 elapsed)
+{
+    //! Small transfers measure latency rather than throughput
+    if (host.isEmpty() || bytes < MIN_THROUGHPUT_SAMPLE_BYTES || elapsed <= 0)
+        return;
+
+    HostStats& stats = hosts_[host];
+    double const throughput = bytes * 8.0 / elapsed;
+    stats.throughput = stats.throughput > 0.0 ? stats.throughput + THROUGHPUT_WEIGHT * (throughput - stats.throughput)
+                                              : throughput;
+    emit statsChanged();
+}
+
+void BufferMonitor::setPreRoll(qint64 preRoll)
+{
+    current_.preRoll = preRoll;
+}
+
+void BufferMonitor::trackMedia(const QMediaContent &media)
+{
+    finishTrack();
+
+    if (media.isNull())
+        return;
+
+    current_ = TrackStats();
+    current_.url = media.canonicalUrl();
+    current_.host = current_.url.host();
+    tracking_ = true;
+    startupTimer_.start();
+}
+
+void BufferMonitor::trackMediaStatus(QMediaPlayer::MediaStatus status)
+{
+    if (!tracking_)
+        return;
+
+    switch (status) {
+    case QMediaPlayer::BufferingMedia:
+    case QMediaPlayer::StalledMedia:
+        //! Only an underrun after the first audible frame counts as a stall
+        if (current_.startupTime >= 0 && !stalled_ && player_->state() == QMediaPlayer::PlayingState)
+        {
+            stalled_ = true;
+            ++current_.stalls;
+            stallTimer_.start();
+        }
+        break;
+    case QMediaPlayer::BufferedMedia:
+        finishStall();
+        break;
+    case QMediaPlayer::EndOfMedia:
+    case QMediaPlayer::InvalidMedia:
+        finishTrack();
+        break;
+    default:
+        break;
+    }
+}
+
+void BufferMonitor::trackPosition(qint64 position)
+{
+    if (!tracking_ || current_.startupTime >= 0 || position <= 0)
+        return;
+
+    current_.startupTime = startupTimer_.elapsed();
+    current_.bufferAtStart = player_->bufferStatus();
+    emit statsChanged();
+}
+
+void BufferMonitor::finishStall()
+{
+    if (!stalled_)
+        return;
+
+    stalled_ = false;
+    current_.stalledTime += stallTimer_.elapsed();
+}
+
+void BufferMonitor::finishTrack()
+{
+    if (!tracking_)
+        return;
+
+    finishStall();
+    tracking_ = false;
+
+    HostStats& stats = hosts_[current_.host];
+    ++stats.tracks;
+    stats.stalls += current_.stalls;
+    stats.stalledTime += current_.stalledTime;
+    stats.startupTime += qMax<qint64>(current_.startupTime, 0);
+    //! Clean tracks pay stall penalties back one at a time
+    stats.recentStalls = current_.stalls > 0 ? stats.recentStalls + current_.stalls : qMax(stats.recentStalls - 1, 0);
+
+    recent_.prepend(current_);
+    if (recent_.size() > RECENT_TRACK_COUNT)
+        recent_.removeLast();
+
+    qDebug("playback: host=%s startup=%lldms buffer=%d%% pre-roll=%lldms stalls=%d stalled=%lldms",
+           qPrintable(current_.host), static_cast<long long>(current_.startupTime), current_.bufferAtStart,
+           static_cast<long long>(current_.preRoll), current_.stalls, static_cast<long long>(current_.stalledTime));
+
+    emit statsChanged();
+}
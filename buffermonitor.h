@@ -0,0 +1,80 @@
+#ifndef BUFFERMONITOR_H
+#define BUFFERMONITOR_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMediaPlayer>
+#include <QObject>
+#include <QUrl>
+
+//! Start-up and rebuffering telemetry of the player, per track and per CDN
+//! host, plus the throughput estimates the adaptive pre-roll is based on
+class BufferMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct TrackStats
+    {
+        QUrl url;
+        QString host;
+        qint64 startupTime;
+        int bufferAtStart;
+        int stalls;
+        qint64 stalledTime;
+        qint64 preRoll;
+
+        TrackStats() : startupTime(-1), bufferAtStart(0), stalls(0), stalledTime(0), preRoll(0) {}
+    };
+
+    struct HostStats
+    {
+        int tracks;
+        int stalls;
+        qint64 stalledTime;
+        qint64 startupTime;
+        int recentStalls;
+        //! Exponentially weighted average, kbit/s; 0 until measured
+        double throughput;
+
+        HostStats() : tracks(0), stalls(0), stalledTime(0), startupTime(0), recentStalls(0), throughput(0.0) {}
+    };
+
+    explicit BufferMonitor(QMediaPlayer *player, QObject *parent = 0);
+    ~BufferMonitor();
+
+    QList<TrackStats> recentTracks() const;
+    QHash<QString, HostStats> hosts() const;
+    TrackStats currentTrack() const;
+
+    //! How long to hold a track of the given bitrate and length (seconds)
+    //! before starting it, so that the host does not run dry mid-track
+    qint64 preRollTime(const QString& host, int bitrate, int duration) const;
+
+    void addThroughputSample(const QString& host, qint64 bytes, qint64 elapsed);
+    void setPreRoll(qint64 preRoll);
+
+signals:
+    void statsChanged();
+
+private slots:
+    void trackMedia(const QMediaContent& media);
+    void trackMediaStatus(QMediaPlayer::MediaStatus status);
+    void trackPosition(qint64 position);
+
+private:
+    void finishStall();
+    void finishTrack();
+
+    QMediaPlayer *player_;
+    TrackStats current_;
+    bool tracking_;
+    bool stalled_;
+    QElapsedTimer startupTimer_;
+    QElapsedTimer stallTimer_;
+    QList<TrackStats> recent_;
+    QHash<QString, HostStats> hosts_;
+};
+
+#endif // BUFFERMONITOR_H
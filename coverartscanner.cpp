@@ -0,0 +1,379 @@
+#include "coverartscanner.h"
+
+#include <cstring>
+#include <limits>
+
+static const int FRONT_COVER = 3;
+static const int ID3_HEADER_SIZE = CoverArtScanner::Id3v2HeaderSize;
+static const int ID3_FOOTER_SIZE = 10;
+static const int ID3_FRAME_HEADER_SIZE = 10;
+static const int ID3_UNSYNCHRONISATION_FLAG = 0x80;
+static const int ID3_EXTENDED_HEADER_FLAG = 0x40;
+static const int ID3_FOOTER_FLAG = 0x10;
+static const int FLAC_PICTURE_BLOCK = 6;
+static const int FLAC_LAST_BLOCK_FLAG = 0x80;
+static const int MP4_JPEG_TYPE = 13;
+static const int MP4_PNG_TYPE = 14;
+static const qint64 MAX_PICTURE_SIZE = std::numeric_limits<int>::max();
+
+static quint32 readBigEndian(const char *data, int bytes)
+{
+    quint32 value = 0;
+    for (int i = 0; i < bytes; ++i)
+        value = (value << 8) | quint8(data[i]);
+    return value;
+}
+
+static quint32 readSyncSafe(const char *data)
+{
+    return (quint32(quint8(data[0]) & 0x7f) << 21) | (quint32(quint8(data[1]) & 0x7f) << 14) |
+            (quint32(quint8(data[2]) & 0x7f) << 7) | quint32(quint8(data[3]) & 0x7f);
+}
+
+//! Payload of the first child atom of the given type; a truncated last
+//! atom yields what is there
+static bool findAtom(const char *data, qint64 size, const char *type, const char *&payload, qint64 &payloadSize)
+{
+    qint64 position = 0;
+    while (position + 8 <= size)
+    {
+        qint64 atomSize = readBigEndian(data + position, 4);
+        qint64 headerSize = 8;
+
+        if (atomSize == 1)
+        {
+            if (position + 16 > size)
+                return false;
+
+            atomSize = qint64(quint64(readBigEndian(data + position + 8, 4)) << 32 | readBigEndian(data + position + 12, 4));
+            headerSize = 16;
+        }
+        else if (atomSize == 0)
+            atomSize = size - position;
+
+        if (atomSize < headerSize)
+            return false;
+
+        if (std::memcmp(data + position + 4, type, 4) == 0)
+        {
+            payload = data + position + headerSize;
+            payloadSize = qMin(atomSize, size - position) - headerSize;
+            return true;
+        }
+
+        if (atomSize > size - position)
+            return false;
+
+        position += atomSize;
+    }
+
+    return false;
+}
+
+bool CoverArtScanner::scan(const QByteArray &media, Picture &picture)
+{
+    return scan(media.constData(), media.size(), picture);
+}
+
+bool CoverArtScanner::scan(const char *data, qint64 size, Picture &picture)
+{
+    picture = Picture();
+    if (!data || size <= 0)
+        return false;
+
+    qint64 tagSize = 0;
+    if (scanId3v2(data, size, picture, tagSize))
+        return true;
+
+    //! FLAC files are sometimes preceded by an ID3v2 tag
+    data += tagSize;
+    size -= tagSize;
+
+    if (size >= 4 && std::memcmp(data, "fLaC", 4) == 0)
+        return scanFlac(data + 4, size - 4, picture);
+
+    if (size >= 8 && std::memcmp(data + 4, "ftyp", 4) == 0)
+        return scanMp4(data, size, picture);
+
+    return false;
+}
+
+qint64 CoverArtScanner::id3v2Size(const char *data, qint64 size)
+{
+    if (size < ID3_HEADER_SIZE || std::memcmp(data, "ID3", 3) != 0)
+        return 0;
+
+    bool const footer = quint8(data[3]) == 4 && (quint8(data[5]) & ID3_FOOTER_FLAG);
+    return ID3_HEADER_SIZE + qint64(readSyncSafe(data + 6)) + (footer ? ID3_FOOTER_SIZE : 0);
+}
+
+bool CoverArtScanner::scanId3v2(const char *data, qint64 size, Picture &picture, qint64 &tagSize)
+{
+    tagSize = qMin(size, id3v2Size(data, size));
+    if (tagSize == 0)
+        return false;
+
+    int const version = quint8(data[3]);
+    int const flags = quint8(data[5]);
+    qint64 const bodySize = readSyncSafe(data + 6);
+
+    if (version != 3 && version != 4)
+        return false;
+
+    //! A tag cut short, as in a prefetched head, is scanned as far as it goes
+    const char *body = data + ID3_HEADER_SIZE;
+    qint64 length = qMin(bodySize, size - ID3_HEADER_SIZE);
+
+    //! In 2.3 unsynchronisation applies to the whole tag, frame headers
+    //! included; in 2.4 it is a property of each frame
+    QByteArray tag;
+    if (version == 3 && (flags & ID3_UNSYNCHRONISATION_FLAG))
+    {
+        tag = removeUnsynchronisation(body, length);
+        body = tag.constData();
+        length = tag.size();
+    }
+
+    if (flags & ID3_EXTENDED_HEADER_FLAG)
+    {
+        if (length < 4)
+            return false;
+
+        qint64 const extendedSize = version == 3 ? qint64(readBigEndian(body, 4)) + 4 : readSyncSafe(body);
+        if (extendedSize < 4 || extendedSize > length)
+            return false;
+
+        body += extendedSize;
+        length -= extendedSize;
+    }
+
+    int bestType = -1;
+    qint64 position = 0;
+
+    while (position + ID3_FRAME_HEADER_SIZE <= length && bestType != FRONT_COVER)
+    {
+        const char * const header = body + position;
+        if (header[0] == 0)
+            break;
+
+        qint64 const frameSize = version == 4 ? readSyncSafe(header + 4) : readBigEndian(header + 4, 4);
+        int const formatFlags = quint8(header[9]);
+        bool const complete = frameSize <= length - position - ID3_FRAME_HEADER_SIZE;
+        position += ID3_FRAME_HEADER_SIZE + frameSize;
+
+        if (!complete || std::memcmp(header, "APIC", 4) != 0)
+            continue;
+
+        const char *frame = header + ID3_FRAME_HEADER_SIZE;
+        qint64 frameLength = frameSize;
+        bool unsynchronised = false;
+        qint64 skipped = 0;
+
+        if (version == 3)
+        {
+            //! Compressed or encrypted
+            if (formatFlags & 0xc0)
+                continue;
+            if (formatFlags & 0x20)
+                skipped += 1;
+        }
+        else
+        {
+            if (formatFlags & 0x0c)
+                continue;
+            if (formatFlags & 0x40)
+                skipped += 1;
+            if (formatFlags & 0x01)
+                skipped += 4;
+            unsynchronised = (formatFlags & 0x02) || (flags & ID3_UNSYNCHRONISATION_FLAG);
+        }
+
+        if (skipped > frameLength)
+            continue;
+
+        frame += skipped;
+        frameLength -= skipped;
+
+        QByteArray owner = tag;
+        if (unsynchronised)
+        {
+            owner = removeUnsynchronisation(frame, frameLength);
+            frame = owner.constData();
+            frameLength = owner.size();
+        }
+
+        Span span;
+        if (readApic(frame, frameLength, span))
+            choose(span, owner, picture, bestType);
+    }
+
+    return !picture.isNull();
+}
+
+bool CoverArtScanner::scanFlac(const char *data, qint64 size, Picture &picture)
+{
+    int bestType = -1;
+    qint64 position = 0;
+
+    while (position + 4 <= size && bestType != FRONT_COVER)
+    {
+        int const header = quint8(data[position]);
+        qint64 const length = readBigEndian(data + position + 1, 3);
+        const char * const block = data + position + 4;
+        bool const complete = length <= size - position - 4;
+        position += 4 + length;
+
+        Span span;
+        if ((header & 0x7f) == FLAC_PICTURE_BLOCK && complete && readFlacPicture(block, length, span))
+            choose(span, QByteArray(), picture, bestType);
+
+        if (header & FLAC_LAST_BLOCK_FLAG)
+            break;
+    }
+
+    return !picture.isNull();
+}
+
+bool CoverArtScanner::scanMp4(const char *data, qint64 size, Picture &picture)
+{
+    const char *moov, *udta, *meta, *ilst, *covr, *image;
+    qint64 moovSize, udtaSize, metaSize, ilstSize, covrSize, imageSize;
+
+    if (!findAtom(data, size, "moov", moov, moovSize) || !findAtom(moov, moovSize, "udta", udta, udtaSize) ||
+            !findAtom(udta, udtaSize, "meta", meta, metaSize))
+        return false;
+
+    //! meta is a full atom, except in some QuickTime files
+    if (metaSize >= 8 && std::memcmp(meta + 4, "hdlr", 4) != 0)
+    {
+        meta += 4;
+        metaSize -= 4;
+    }
+
+    if (!findAtom(meta, metaSize, "ilst", ilst, ilstSize) || !findAtom(ilst, ilstSize, "covr", covr, covrSize) ||
+            !findAtom(covr, covrSize, "data", image, imageSize))
+        return false;
+
+    //! Type indicator and locale precede the image
+    if (imageSize <= 8 || imageSize - 8 > MAX_PICTURE_SIZE)
+        return false;
+
+    int const type = readBigEndian(image, 4) & 0xffffff;
+    picture.data = image + 8;
+    picture.size = int(imageSize - 8);
+    if (type == MP4_JPEG_TYPE)
+        picture.format = "JPEG";
+    else if (type == MP4_PNG_TYPE)
+        picture.format = "PNG";
+    else
+        picture.format = sniffFormat(picture.data, picture.size);
+
+    return true;
+}
+
+bool CoverArtScanner::readApic(const char *data, qint64 size, Span &span)
+{
+    //! Encoding, latin-1 MIME type, picture type, description, image
+    if (size < 4)
+        return false;
+
+    int const encoding = quint8(data[0]);
+    const char * const mimeEnd = static_cast<const char*>(std::memchr(data + 1, 0, size - 1));
+    if (!mimeEnd || (mimeEnd - data == 4 && std::memcmp(data + 1, "-->", 3) == 0))
+        return false;
+
+    qint64 position = mimeEnd - data + 1;
+    if (position >= size)
+        return false;
+
+    span.pictureType = quint8(data[position++]);
+
+    if (encoding == 1 || encoding == 2)
+    {
+        //! UTF-16 ends with a zero character, not just a zero byte
+        while (position + 1 < size && (data[position] || data[position + 1]))
+            position += 2;
+        position += 2;
+    }
+    else
+    {
+        const char * const end = static_cast<const char*>(std::memchr(data + position, 0, size - position));
+        if (!end)
+            return false;
+        position = end - data + 1;
+    }
+
+    if (position >= size || size - position > MAX_PICTURE_SIZE)
+        return false;
+
+    span.data = data + position;
+    span.size = size - position;
+    return true;
+}
+
+bool CoverArtScanner::readFlacPicture(const char *data, qint64 size, Span &span)
+{
+    //! Type, MIME type, description, four dimension fields, image
+    if (size < 32)
+        return false;
+
+    span.pictureType = int(readBigEndian(data, 4));
+    qint64 position = 4;
+
+    qint64 const mimeLength = readBigEndian(data + position, 4);
+    if (mimeLength > size - position - 8)
+        return false;
+    position += 4 + mimeLength;
+
+    qint64 const descriptionLength = readBigEndian(data + position, 4);
+    if (descriptionLength > size - position - 24)
+        return false;
+    position += 4 + descriptionLength + 16;
+
+    qint64 const dataLength = readBigEndian(data + position, 4);
+    position += 4;
+    if (dataLength == 0 || dataLength > size - position || dataLength > MAX_PICTURE_SIZE)
+        return false;
+
+    span.data = data + position;
+    span.size = dataLength;
+    return true;
+}
+
+void CoverArtScanner::choose(const Span &span, const QByteArray &decoded, Picture &picture, int &bestType)
+{
+    //! The first picture, unless a later one is the front cover
+    if (!picture.isNull() && (bestType == FRONT_COVER || span.pictureType != FRONT_COVER))
+        return;
+
+    picture.data = span.data;
+    picture.size = int(span.size);
+    picture.format = sniffFormat(span.data, span.size);
+    picture.decoded = decoded;
+    bestType = span.pictureType;
+}
+
+QByteArray CoverArtScanner::removeUnsynchronisation(const char *data, qint64 size)
+{
+    QByteArray decoded(int(qMin(size, MAX_PICTURE_SIZE)), Qt::Uninitialized);
+    char *out = decoded.data();
+
+    for (qint64 i = 0; i < decoded.size(); ++i)
+    {
+        *out++ = data[i];
+        if (quint8(data[i]) == 0xff && i + 1 < size && data[i + 1] == 0)
+            ++i;
+    }
+
+    decoded.resize(int(out - decoded.constData()));
+    return decoded;
+}
+
+const char * CoverArtScanner::sniffFormat(const char *data, qint64 size)
+{
+    if (size >= 3 && std::memcmp(data, "\xff\xd8\xff", 3) == 0)
+        return "JPEG";
+    if (size >= 8 && std::memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0)
+        return "PNG";
+    return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef COVERARTSCANNER_H
+#define COVERARTSCANNER_H
+
+#include <QByteArray>
+
+//! Finds the embedded cover of an MP3 (ID3v2.3/2.4 APIC), FLAC (PICTURE
+//! block) or MP4 (covr atom) file held in memory, without parsing any
+//! other frame. The picture points into the scanned bytes; only frames
+//! stored with ID3 unsynchronisation are decoded into a copy of their own.
+//! A front cover wins over other picture types.
+class CoverArtScanner
+{
+public:
+    enum
+    {
+        Id3v2HeaderSize = 10
+    };
+
+    struct Picture
+    {
+        const char *data;
+        int size;
+        //! "JPEG" or "PNG" when recognised, otherwise 0
+        const char *format;
+        QByteArray decoded;
+
+        Picture() : data(0), size(0), format(0) {}
+        bool isNull() const { return size == 0; }
+    };
+
+    static bool scan(const char *data, qint64 size, Picture& picture);
+    static bool scan(const QByteArray& media, Picture& picture);
+    //! Length of the ID3v2 tag the data starts with, read from its header;
+    //! 0 without one
+    static qint64 id3v2Size(const char *data, qint64 size);
+
+private:
+    struct Span
+    {
+        const char *data;
+        qint64 size;
+        int pictureType;
+    };
+
+    static bool scanId3v2(const char *data, qint64 size, Picture& picture, qint64& tagSize);
+    static bool scanFlac(const char *data, qint64 size, Picture& picture);
+    static bool scanMp4(const char *data, qint64 size, Picture& picture);
+    static bool readApic(const char *data, qint64 size, Span& span);
+    static bool readFlacPicture(const char *data, qint64 size, Span& span);
+    static void choose(const Span& span, const QByteArray& decoded, Picture& picture, int& bestType);
+    static QByteArray removeUnsynchronisation(const char *data, qint64 size);
+    static const char * sniffFormat(const char *data, qint64 size);
+};
+
+#endif // COVERARTSCANNER_H
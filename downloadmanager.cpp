@@ -0,0 +1,340 @@
+#include "downloadmanager.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QStandardPaths>
+#include <QTimer>
+
+static const int DEFAULT_MAX_CONCURRENCY = 4;
+static const int MAX_ATTEMPTS = 5;
+static const int RETRY_DELAY = 2000;
+static const qint64 READ_BUFFER_SIZE = 64 * 1024;
+static const int PROGRESS_PUBLISH_INTERVAL = 250;
+static const QString TRACK_SUFFIX = ".mp3";
+static const QString PARTIAL_SUFFIX = ".part";
+
+DownloadManager::DownloadManager(QNetworkAccessManager *networkManager, QObject *parent) : QObject(parent),
+    networkManager_(networkManager), directory_(QStandardPaths::writableLocation(QStandardPaths::DataLocation) + "/offline"),
+    maxConcurrency_(DEFAULT_MAX_CONCURRENCY), throttled_(false), progressDirty_(false), publishTimer_(new QTimer(this))
+{
+    Q_ASSERT(networkManager);
+
+    QDir().mkpath(directory_);
+    foreach (const QString& name, QDir(directory_).entryList(QStringList() << "*" + TRACK_SUFFIX, QDir::Files))
+        available_.insert(name.left(name.size() - TRACK_SUFFIX.size()));
+
+    publishTimer_->setInterval(PROGRESS_PUBLISH_INTERVAL);
+    connect(publishTimer_, &QTimer::timeout, this, &DownloadManager::publishProgress);
+}
+
+DownloadManager::~DownloadManager()
+{
+    pending_.clear();
+
+    foreach (QNetworkReply *reply, active_.keys())
+        release(reply);
+}
+
+void DownloadManager::setMaxConcurrency(int maxConcurrency)
+{
+    Q_ASSERT(maxConcurrency > 0);
+
+    maxConcurrency_ = maxConcurrency;
+    pump();
+}
+
+int DownloadManager::progress(const QUrl &url) const
+{
+    QString const key = trackKey(url);
+    return available_.contains(key) ? 100 : progress_.value(key, -1);
+}
+
+bool DownloadManager::isAvailable(const QUrl &url) const
+{
+    return available_.contains(trackKey(url));
+}
+
+QUrl DownloadManager::localUrl(const QUrl &url) const
+{
+    QString const key = trackKey(url);
+    return available_.contains(key) ? QUrl::fromLocalFile(fileName(key)) : url;
+}
+
+int DownloadManager::pendingCount() const
+{
+    return pending_.size() + active_.size();
+}
+
+void DownloadManager::pin(const PlaylistModel::Tracks &tracks)
+{
+    foreach (const PlaylistModel::Track& track, tracks)
+    {
+        if (track.url.isLocalFile())
+            continue;
+
+        QString const key = trackKey(track.url);
+        if (available_.contains(key) || progress_.contains(key))
+            continue;
+
+        Download download;
+        download.url = track.url;
+        download.id = track.id;
+        download.key = key;
+        download.attempt = 0;
+        download.received = 0;
+        download.total = track.size;
+        download.started = false;
+        download.file = 0;
+        pending_.append(download);
+        setProgress(key, 0);
+    }
+
+    pump();
+}
+
+void DownloadManager::refreshUrls(const PlaylistModel::Tracks &tracks)
+{
+    foreach (const PlaylistModel::Track& track, tracks)
+    {
+        QString const key = expired_.take(track.id);
+        if (!key.isEmpty())
+            refreshed_.insert(key, track.url);
+    }
+}
+
+void DownloadManager::cancelAll()
+{
+    foreach (const Download& download, pending_)
+        progress_.remove(download.key);
+    pending_.clear();
+    expired_.clear();
+    refreshed_.clear();
+
+    foreach (QNetworkReply *reply, active_.keys())
+    {
+        progress_.remove(active_.value(reply).key);
+        release(reply);
+    }
+
+    progressDirty_ = true;
+    publishProgress();
+}
+
+void DownloadManager::setThrottled(bool throttled)
+{
+    if (throttled_ == throttled)
+        return;
+
+    throttled_ = throttled;
+
+    //! Data held back while throttled is still waiting in the read buffers
+    if (!throttled_)
+    {
+        foreach (QNetworkReply *reply, active_.keys())
+            drain(reply);
+    }
+}
+
+void DownloadManager::readDownloadData()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (reply && active_.contains(reply) && isDrained(reply))
+        drain(reply);
+}
+
+void DownloadManager::finishDownload()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply || !active_.contains(reply))
+        return;
+
+    drain(reply);
+
+    Download download = active_.value(reply);
+    int const status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    //! Only a 200 or 206 body counts; a range starting at the end of the
+    //! file means the partial file was complete
+    bool const complete = (reply->error() == QNetworkReply::NoError && download.started &&
+                           (download.total <= 0 || download.received >= download.total)) || status == 416;
+
+    download.file->close();
+    release(reply);
+
+    if (complete)
+    {
+        QFile::remove(fileName(download.key));
+        if (QFile::rename(partialFileName(download.key), fileName(download.key)))
+        {
+            progress_.remove(download.key);
+            available_.insert(download.key);
+            progressDirty_ = true;
+        }
+    }
+    else if (++download.attempt < MAX_ATTEMPTS)
+    {
+        //! The signature may have expired, so a fresh url is requested now
+        //! and used if it arrives before the retry
+        if (!download.id.isEmpty())
+        {
+            expired_.insert(download.id, download.key);
+            emit urlsExpired(QStringList() << download.id);
+        }
+
+        //! The partial file stays; the next attempt continues where this one stopped
+        QTimer::singleShot(RETRY_DELAY * download.attempt, this, [this, download]() mutable
+        {
+            expired_.remove(download.id);
+            QUrl const fresh = refreshed_.take(download.key);
+            if (fresh.isValid())
+                download.url = fresh;
+
+            if (progress_.contains(download.key))
+            {
+                pending_.append(download);
+                pump();
+            }
+        });
+    }
+    else
+        setProgress(download.key, -1);
+
+    pump();
+}
+
+void DownloadManager::publishProgress()
+{
+    if (progressDirty_)
+    {
+        progressDirty_ = false;
+        emit progressUpdated();
+    }
+
+    if (active_.isEmpty() && pending_.isEmpty())
+        publishTimer_->stop();
+}
+
+void DownloadManager::pump()
+{
+    while (active_.size() < maxConcurrency_ && !pending_.isEmpty())
+        start(pending_.takeFirst());
+
+    //! The drained transfer may have just finished; hand over to the next one
+    if (throttled_ && !active_.isEmpty())
+        drain(active_.constBegin().key());
+
+    if (!active_.isEmpty() && !publishTimer_->isActive())
+        publishTimer_->start();
+}
+
+void DownloadManager::start(Download download)
+{
+    download.file = new QFile(partialFileName(download.key));
+    if (!download.file->open(QIODevice::ReadWrite))
+    {
+        delete download.file;
+        setProgress(download.key, -1);
+        return;
+    }
+
+    download.received = download.file->size();
+    download.started = false;
+    download.file->seek(download.received);
+
+    QNetworkRequest networkRequest(download.url);
+    networkRequest.setPriority(QNetworkRequest::LowPriority);
+    if (download.received > 0)
+        networkRequest.setRawHeader("Range", "bytes=" + QByteArray::number(download.received) + "-");
+
+    QNetworkReply *reply = networkManager_->get(networkRequest);
+    //! A small read buffer keeps memory flat and lets TCP push back on the server
+    reply->setReadBufferSize(READ_BUFFER_SIZE);
+    active_.insert(reply, download);
+
+    connect(reply, &QNetworkReply::readyRead, this, &DownloadManager::readDownloadData);
+    connect(reply, &QNetworkReply::finished, this, &DownloadManager::finishDownload);
+}
+
+void DownloadManager::drain(QNetworkReply *reply)
+{
+    Download& download = active_[reply];
+
+    if (!download.started)
+    {
+        int const status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (status != 200 && status != 206)
+            return;
+
+        download.started = true;
+        if (status == 200 && download.received > 0)
+        {
+            //! The server ignored the range and sends the whole file again
+            download.file->resize(0);
+            download.file->seek(0);
+            download.received = 0;
+        }
+
+        qint64 const length = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+        if (length > 0)
+            download.total = download.received + length;
+    }
+
+    while (reply->bytesAvailable() > 0)
+    {
+        QByteArray const data = reply->read(READ_BUFFER_SIZE);
+        if (download.file->write(data) != data.size())
+        {
+            reply->abort();
+            return;
+        }
+        download.received += data.size();
+    }
+
+    if (download.total > 0)
+        setProgress(download.key, int(qMin<qint64>(99, download.received * 100 / download.total)));
+}
+
+void DownloadManager::release(QNetworkReply *reply)
+{
+    Download const download = active_.take(reply);
+    delete download.file;
+
+    disconnect(reply, 0, this, 0);
+    reply->abort();
+    reply->deleteLater();
+}
+
+void DownloadManager::setProgress(const QString &key, int progress)
+{
+    if (progress < 0)
+        progress_.remove(key);
+    else if (progress_.value(key, -1) != progress)
+        progress_.insert(key, progress);
+    else
+        return;
+
+    progressDirty_ = true;
+}
+
+bool DownloadManager::isDrained(QNetworkReply *reply) const
+{
+    //! While throttled a single transfer keeps moving
+    return !throttled_ || reply == active_.constBegin().key();
+}
+
+QString DownloadManager::fileName(const QString &key) const
+{
+    return directory_ + "/" + key + TRACK_SUFFIX;
+}
+
+QString DownloadManager::partialFileName(const QString &key) const
+{
+    return directory_ + "/" + key + PARTIAL_SUFFIX;
+}
+
+QString DownloadManager::trackKey(const QUrl &url)
+{
+    return QCryptographicHash::hash(PlaylistModel::streamKey(url).toUtf8(), QCryptographicHash::Sha1).toHex();
+}
@@ -0,0 +1,99 @@
+#ifndef DOWNLOADMANAGER_H
+#define DOWNLOADMANAGER_H
+
+#include "playlistmodel.h"
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QUrl>
+
+class QFile;
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+
+//! Keeps pinned tracks on disk for offline listening. Tracks are fetched
+//! over a bounded pool of connections and streamed into partial files,
+//! which later attempts resume with HTTP ranges.
+class DownloadManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DownloadManager(QNetworkAccessManager *networkManager, QObject *parent = 0);
+    ~DownloadManager();
+
+    void setMaxConcurrency(int maxConcurrency);
+
+    //! -1 when the track is not pinned, 100 once it is on disk
+    int progress(const QUrl& url) const;
+    bool isAvailable(const QUrl& url) const;
+    //! The file of an available track, the url itself otherwise
+    QUrl localUrl(const QUrl& url) const;
+    int pendingCount() const;
+
+signals:
+    //! Coalesced; views repaint whatever rows they show
+    void progressUpdated();
+    //! A failed transfer wants fresh signed urls for these owner_aid ids
+    //! before its next attempt
+    void urlsExpired(const QStringList& ids);
+
+public slots:
+    void pin(const PlaylistModel::Tracks& tracks);
+    //! Re-signed urls, picked up by retries that are still waiting
+    void refreshUrls(const PlaylistModel::Tracks& tracks);
+    void cancelAll();
+    //! While throttled only one connection is drained, the others are left
+    //! to back off in TCP flow control so the playing stream gets the link
+    void setThrottled(bool throttled);
+
+private slots:
+    void readDownloadData();
+    void finishDownload();
+    void publishProgress();
+
+private:
+    struct Download
+    {
+        QUrl url;
+        QString id;
+        QString key;
+        int attempt;
+        qint64 received;
+        qint64 total;
+        bool started;
+        QFile *file;
+    };
+
+    void pump();
+    void start(Download download);
+    void drain(QNetworkReply *reply);
+    void release(QNetworkReply *reply);
+    void setProgress(const QString& key, int progress);
+    bool isDrained(QNetworkReply *reply) const;
+
+    QString fileName(const QString& key) const;
+    QString partialFileName(const QString& key) const;
+
+    static QString trackKey(const QUrl& url);
+
+    QNetworkAccessManager *networkManager_;
+    QString directory_;
+    QList<Download> pending_;
+    QHash<QNetworkReply*, Download> active_;
+    QHash<QString, int> progress_;
+    //! Track id to key of the retries waiting for a fresh url
+    QHash<QString, QString> expired_;
+    QHash<QString, QUrl> refreshed_;
+    QSet<QString> available_;
+    int maxConcurrency_;
+    bool throttled_;
+    bool progressDirty_;
+    QTimer *publishTimer_;
+};
+
+#endif // DOWNLOADMANAGER_H
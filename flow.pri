@@ -0,0 +1,69 @@
+# Application sources, shared by the flow binary and by the tests and
+# benchmarks in tests/
+
+QT       += core gui network webenginewidgets xml multimedia concurrent
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+QMAKE_CXXFLAGS += -std=c++11
+
+LIBS += -ltag
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += $$PWD/mainwindow.cpp \
+    $$PWD/mediacomponent.cpp \
+    $$PWD/apicomponent.cpp \
+    $$PWD/playerwidget.cpp \
+    $$PWD/waveformcomponent.cpp \
+    $$PWD/shuffleorder.cpp \
+    $$PWD/playlistmodel.cpp \
+    $$PWD/playlistitemdelegate.cpp \
+    $$PWD/apirequestscheduler.cpp \
+    $$PWD/trackprober.cpp \
+    $$PWD/librarycomponent.cpp \
+    $$PWD/resourcemonitor.cpp \
+    $$PWD/resourcepanel.cpp \
+    $$PWD/playlistsortmodel.cpp \
+    $$PWD/spectrumanalyzer.cpp \
+    $$PWD/playlistingestor.cpp \
+    $$PWD/buffermonitor.cpp \
+    $$PWD/playbackstatspanel.cpp \
+    $$PWD/downloadmanager.cpp \
+    $$PWD/urlresolver.cpp \
+    $$PWD/instanceguard.cpp \
+    $$PWD/radiomode.cpp \
+    $$PWD/prefetcher.cpp \
+    $$PWD/coverartscanner.cpp
+
+HEADERS  += $$PWD/mainwindow.h \
+    $$PWD/mediacomponent.h \
+    $$PWD/apicomponent.h \
+    $$PWD/playerwidget.h \
+    $$PWD/waveformcomponent.h \
+    $$PWD/shuffleorder.h \
+    $$PWD/playlistmodel.h \
+    $$PWD/playlistitemdelegate.h \
+    $$PWD/apirequestscheduler.h \
+    $$PWD/trackprober.h \
+    $$PWD/librarycomponent.h \
+    $$PWD/resourcemonitor.h \
+    $$PWD/resourcepanel.h \
+    $$PWD/playlistsortmodel.h \
+    $$PWD/spectrumanalyzer.h \
+    $$PWD/playlistingestor.h \
+    $$PWD/buffermonitor.h \
+    $$PWD/playbackstatspanel.h \
+    $$PWD/downloadmanager.h \
+    $$PWD/urlresolver.h \
+    $$PWD/instanceguard.h \
+    $$PWD/radiomode.h \
+    $$PWD/prefetcher.h \
+    $$PWD/coverartscanner.h
+
+FORMS    += $$PWD/mainwindow.ui \
+    $$PWD/playerwidget.ui
+
+RESOURCES += \
+    $$PWD/icons.qrc
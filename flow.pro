@@ -4,33 +4,12 @@
 #
 #-------------------------------------------------
 
-QT       += core gui webenginewidgets xml multimedia
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+include(flow.pri)
 
 TARGET = flow
 TEMPLATE = app
 
-QMAKE_CXXFLAGS += -std=c++11
-
-LIBS += -ltag
-
-SOURCES += main.cpp\
-        mainwindow.cpp \
-    mediacomponent.cpp \
-    apicomponent.cpp \
-    playerwidget.cpp
-
-HEADERS  += mainwindow.h \
-    mediacomponent.h \
-    apicomponent.h \
-    playerwidget.h
-
-FORMS    += mainwindow.ui \
-    playerwidget.ui
-
-RESOURCES += \
-    icons.qrc
+SOURCES += main.cpp
 
 DISTFILES += \
     README.md
@@ -0,0 +1,106 @@
+#include "instanceguard.h"
+
+#include <QDir>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+static const int FORWARD_TIMEOUT = 500;
+static const int STARTUP_LOCK_TIMEOUT = 2000;
+static const qint64 MAX_COMMAND_LENGTH = 4096;
+static const QStringList COMMANDS = QStringList() << "play" << "pause" << "play-pause" << "next" << "previous"
+                                                  << "show" << "search";
+
+InstanceGuard::InstanceGuard(QObject *parent) : QObject(parent), server_(new QLocalServer(this)),
+    startupLock_(QDir::temp().absoluteFilePath(serverName() + ".lock"))
+{
+    server_->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(server_, &QLocalServer::newConnection, this, &InstanceGuard::acceptConnections);
+}
+
+bool InstanceGuard::isCommand(const QString &command)
+{
+    return COMMANDS.contains(command);
+}
+
+bool InstanceGuard::forward(const QString &command, const QString &argument)
+{
+    Q_ASSERT(isCommand(command));
+
+    //! Without a listening instance the connect fails right away
+    QLocalSocket socket;
+    socket.connectToServer(serverName());
+    if (!socket.waitForConnected(FORWARD_TIMEOUT))
+        return false;
+
+    QString line = command;
+    if (!argument.isEmpty())
+        line += ' ' + argument;
+
+    socket.write(line.toUtf8() + '\n');
+    bool const written = socket.waitForBytesWritten(FORWARD_TIMEOUT);
+    socket.disconnectFromServer();
+    return written;
+}
+
+bool InstanceGuard::listen()
+{
+    if (!startupLock_.tryLock(STARTUP_LOCK_TIMEOUT))
+        return false;
+
+    bool listening = server_->listen(serverName());
+
+    //! The socket of an instance that crashed is left behind; it is only
+    //! removed when nothing accepts connections on it any more
+    if (!listening && server_->serverError() == QAbstractSocket::AddressInUseError && !isServerAlive())
+    {
+        QLocalServer::removeServer(serverName());
+        listening = server_->listen(serverName());
+    }
+
+    startupLock_.unlock();
+    return listening;
+}
+
+void InstanceGuard::acceptConnections()
+{
+    while (QLocalSocket *socket = server_->nextPendingConnection())
+    {
+        connect(socket, &QLocalSocket::readyRead, this, &InstanceGuard::readCommands);
+        connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
+    }
+}
+
+void InstanceGuard::readCommands()
+{
+    QLocalSocket * const socket = qobject_cast<QLocalSocket*>(sender());
+    Q_ASSERT(socket);
+
+    while (socket->canReadLine())
+    {
+        QString const line = QString::fromUtf8(socket->readLine(MAX_COMMAND_LENGTH)).trimmed();
+        int const space = line.indexOf(' ');
+        QString const command = space < 0 ? line : line.left(space);
+
+        if (isCommand(command))
+            emit commandReceived(command, space < 0 ? QString() : line.mid(space + 1).trimmed());
+    }
+
+    if (!socket->canReadLine() && socket->bytesAvailable() > MAX_COMMAND_LENGTH)
+        socket->abort();
+}
+
+QString InstanceGuard::serverName()
+{
+    return "flow-" + QDir::home().dirName();
+}
+
+bool InstanceGuard::isServerAlive()
+{
+    QLocalSocket socket;
+    socket.connectToServer(serverName());
+    if (!socket.waitForConnected(FORWARD_TIMEOUT))
+        return false;
+
+    socket.disconnectFromServer();
+    return true;
+}
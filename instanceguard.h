@@ -0,0 +1,47 @@
+#ifndef INSTANCEGUARD_H
+#define INSTANCEGUARD_H
+
+#include <QLockFile>
+#include <QObject>
+#include <QStringList>
+
+class QLocalServer;
+class QLocalSocket;
+
+//! Keeps Flow to one instance per user: the running instance listens on a
+//! local socket and a relaunch hands its command line over and exits
+//! before any GUI is built
+class InstanceGuard : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit InstanceGuard(QObject *parent = 0);
+
+    //! play, pause, play-pause, next, previous, show and search <text>
+    static bool isCommand(const QString& command);
+
+    //! Delivers the command to the running instance; false when none runs
+    static bool forward(const QString& command, const QString& argument);
+
+    //! False when another instance owns the socket or it cannot be bound
+    bool listen();
+
+signals:
+    void commandReceived(const QString& command, const QString& argument);
+
+private slots:
+    void acceptConnections();
+    void readCommands();
+
+private:
+    static QString serverName();
+    static bool isServerAlive();
+
+    QLocalServer *server_;
+    //! Held while binding, so that two launches cannot both take a socket
+    //! left behind by a crash
+    QLockFile startupLock_;
+};
+
+#endif // INSTANCEGUARD_H
@@ -0,0 +1,421 @@
+#include "librarycomponent.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QtConcurrent>
+
+#include <taglib/fileref.h>
+#include <taglib/tag.h>
+
+static const QStringList AUDIO_FILE_SUFFIXES = QStringList() << "mp3" << "flac" << "ogg" << "oga" << "opus" << "m4a" << "wav";
+static const quint32 INDEX_MAGIC = 0x464c4f57;
+static const quint16 INDEX_VERSION = 1;
+static const int DIRTY_SETTLE_DELAY = 2000;
+static const int POLL_INTERVAL = 10 * 60 * 1000;
+static const int UNWATCHED_POLL_INTERVAL = 60 * 1000;
+
+namespace
+{
+
+struct DirectoryListing
+{
+    QString path;
+    bool exists;
+    QList<LibraryComponent::Entry> files;
+    QStringList subdirectories;
+};
+
+DirectoryListing listDirectory(const QString& path)
+{
+    DirectoryListing listing;
+    listing.path = path;
+
+    QDir const directory(path);
+    listing.exists = directory.exists();
+    if (!listing.exists)
+        return listing;
+
+    QFileInfoList const infos = directory.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Readable,
+                                                        QDir::NoSort);
+    foreach (const QFileInfo& info, infos)
+    {
+        if (info.isDir())
+        {
+            if (!info.isSymLink())
+                listing.subdirectories.append(info.absoluteFilePath());
+        }
+        else if (AUDIO_FILE_SUFFIXES.contains(info.suffix().toLower()))
+        {
+            LibraryComponent::Entry entry;
+            entry.path = info.absoluteFilePath();
+            entry.modified = info.lastModified().toMSecsSinceEpoch();
+            entry.size = info.size();
+            listing.files.append(entry);
+        }
+    }
+
+    return listing;
+}
+
+LibraryComponent::Entry readTags(const LibraryComponent::Entry& file)
+{
+    LibraryComponent::Entry entry = file;
+    TagLib::FileRef fileRef(QFile::encodeName(entry.path).constData());
+
+    if (!fileRef.isNull() && fileRef.tag())
+    {
+        entry.artist = TStringToQString(fileRef.tag()->artist()).trimmed();
+        entry.title = TStringToQString(fileRef.tag()->title()).trimmed();
+    }
+
+    if (!fileRef.isNull() && fileRef.audioProperties())
+    {
+        entry.duration = fileRef.audioProperties()->length();
+        entry.bitrate = fileRef.audioProperties()->bitrate();
+    }
+
+    if (entry.title.isEmpty())
+        entry.title = QFileInfo(entry.path).completeBaseName();
+
+    return entry;
+}
+
+QString parentPath(const QString& path)
+{
+    return path.left(path.lastIndexOf('/'));
+}
+
+//! Lists directories level by level, every level in parallel
+void walk(QStringList level, const QSet<QString>& known, QList<DirectoryListing>& listings)
+{
+    while (!level.isEmpty())
+    {
+        QList<DirectoryListing> const current = QtConcurrent::blockingMapped(level, listDirectory);
+        level.clear();
+
+        foreach (const DirectoryListing& listing, current)
+        {
+            listings.append(listing);
+            foreach (const QString& subdirectory, listing.subdirectories)
+            {
+                if (!known.contains(subdirectory))
+                    level.append(subdirectory);
+            }
+        }
+    }
+}
+
+void removeSubtree(LibraryComponent::ScanResult& result, const QString& path)
+{
+    QString const prefix = path + '/';
+
+    for (LibraryComponent::Index::iterator it = result.entries.begin(); it != result.entries.end();)
+    {
+        if (it.key().startsWith(prefix))
+            it = result.entries.erase(it);
+        else
+            ++it;
+    }
+
+    for (QSet<QString>::iterator it = result.directories.begin(); it != result.directories.end();)
+    {
+        if (*it == path || it->startsWith(prefix))
+            it = result.directories.erase(it);
+        else
+            ++it;
+    }
+}
+
+void saveIndex(const QString& fileName, const QStringList& roots, const LibraryComponent::ScanResult& result)
+{
+    QDir().mkpath(QFileInfo(fileName).path());
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream stream(&file);
+    stream << INDEX_MAGIC << INDEX_VERSION << roots << result.directories.toList() << quint32(result.entries.size());
+
+    foreach (const LibraryComponent::Entry& entry, result.entries)
+    {
+        stream << entry.path.toUtf8() << entry.modified << entry.size << entry.artist.toUtf8()
+               << entry.title.toUtf8() << qint32(entry.duration) << qint32(entry.bitrate);
+    }
+
+    file.commit();
+}
+
+//! An empty dirty list walks every root; otherwise only the dirty
+//! directories are relisted and only unknown subdirectories are descended
+LibraryComponent::ScanResult scan(const QStringList& roots, const QStringList& dirty,
+                                  const LibraryComponent::ScanResult& previous, const QString& indexFileName)
+{
+    LibraryComponent::ScanResult result;
+    QList<DirectoryListing> listings;
+
+    if (dirty.isEmpty())
+        walk(roots, QSet<QString>(), listings);
+    else
+    {
+        result = previous;
+        walk(dirty, previous.directories, listings);
+    }
+
+    QList<LibraryComponent::Entry> changed;
+
+    foreach (const DirectoryListing& listing, listings)
+    {
+        if (!listing.exists)
+        {
+            removeSubtree(result, listing.path);
+            continue;
+        }
+
+        if (!dirty.isEmpty() && dirty.contains(listing.path))
+        {
+            for (LibraryComponent::Index::iterator it = result.entries.begin(); it != result.entries.end();)
+            {
+                if (parentPath(it.key()) == listing.path)
+                    it = result.entries.erase(it);
+                else
+                    ++it;
+            }
+
+            foreach (const QString& directory, previous.directories)
+            {
+                if (parentPath(directory) == listing.path && !listing.subdirectories.contains(directory))
+                    removeSubtree(result, directory);
+            }
+        }
+
+        result.directories.insert(listing.path);
+
+        foreach (const LibraryComponent::Entry& file, listing.files)
+        {
+            LibraryComponent::Index::const_iterator const known = previous.entries.constFind(file.path);
+            if (known != previous.entries.constEnd() && known->modified == file.modified && known->size == file.size)
+                result.entries.insert(file.path, *known);
+            else
+                changed.append(file);
+        }
+    }
+
+    if (!changed.isEmpty())
+    {
+        QList<LibraryComponent::Entry> const tagged = QtConcurrent::blockingMapped(changed, readTags);
+        foreach (const LibraryComponent::Entry& entry, tagged)
+            result.entries.insert(entry.path, entry);
+    }
+
+    saveIndex(indexFileName, roots, result);
+
+    return result;
+}
+
+}
+
+LibraryComponent::LibraryComponent(QObject *parent) : QObject(parent), rescanRequested_(false),
+    fileSystemWatcher_(new QFileSystemWatcher(this)), dirtyTimer_(new QTimer(this)), pollTimer_(new QTimer(this))
+{
+    //! Scans are serialized; the parallel work inside runs on the global pool
+    scanPool_.setMaxThreadCount(1);
+
+    dirtyTimer_->setSingleShot(true);
+    dirtyTimer_->setInterval(DIRTY_SETTLE_DELAY);
+
+    connect(fileSystemWatcher_, &QFileSystemWatcher::directoryChanged, this, &LibraryComponent::markDirty);
+    connect(dirtyTimer_, &QTimer::timeout, this, &LibraryComponent::rescanDirty);
+    connect(pollTimer_, &QTimer::timeout, this, &LibraryComponent::rescan);
+    connect(&scanWatcher_, &QFutureWatcher<ScanResult>::finished, this, &LibraryComponent::applyScanResult);
+}
+
+LibraryComponent::~LibraryComponent()
+{
+    scanWatcher_.waitForFinished();
+}
+
+QStringList LibraryComponent::directories() const
+{
+    return roots_;
+}
+
+PlaylistModel::Tracks LibraryComponent::tracks() const
+{
+    QStringList paths = entries_.keys();
+    paths.sort();
+
+    PlaylistModel::Tracks tracks;
+    tracks.reserve(paths.size());
+
+    foreach (const QString& path, paths)
+    {
+        Entry const entry = entries_.value(path);
+
+        PlaylistModel::Track track;
+        track.artist = entry.artist;
+        track.title = entry.title;
+        track.duration = entry.duration;
+        track.durationText = PlaylistModel::formatDuration(entry.duration);
+        track.url = QUrl::fromLocalFile(entry.path);
+        track.bitrate = entry.bitrate;
+        track.size = entry.size;
+        tracks.append(track);
+    }
+
+    return tracks;
+}
+
+bool LibraryComponent::isScanning() const
+{
+    return scanWatcher_.isRunning();
+}
+
+void LibraryComponent::load()
+{
+    QFile file(indexFileName());
+    if (file.open(QIODevice::ReadOnly))
+    {
+        QDataStream stream(&file);
+        quint32 magic = 0;
+        quint16 version = 0;
+        stream >> magic >> version;
+
+        if (magic == INDEX_MAGIC && version == INDEX_VERSION)
+        {
+            QStringList directories;
+            quint32 count = 0;
+            stream >> roots_ >> directories >> count;
+            directories_ = directories.toSet();
+            entries_.reserve(count);
+
+            for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+            {
+                QByteArray path, artist, title;
+                qint32 duration = 0, bitrate = 0;
+                Entry entry;
+                stream >> path >> entry.modified >> entry.size >> artist >> title >> duration >> bitrate;
+                entry.path = QString::fromUtf8(path);
+                entry.artist = QString::fromUtf8(artist);
+                entry.title = QString::fromUtf8(title);
+                entry.duration = duration;
+                entry.bitrate = bitrate;
+                entries_.insert(entry.path, entry);
+            }
+        }
+    }
+
+    watchDirectories();
+    emit libraryChanged();
+
+    if (!roots_.isEmpty())
+        rescan();
+}
+
+void LibraryComponent::addDirectory(const QString &path)
+{
+    QString const directory = QDir(path).absolutePath();
+    if (directory.isEmpty() || roots_.contains(directory))
+        return;
+
+    roots_.append(directory);
+    startScan(QStringList() << directory);
+}
+
+void LibraryComponent::removeDirectory(const QString &path)
+{
+    if (roots_.removeAll(QDir(path).absolutePath()) > 0)
+        rescan();
+}
+
+void LibraryComponent::rescan()
+{
+    startScan(QStringList());
+}
+
+void LibraryComponent::markDirty(const QString &path)
+{
+    dirty_.insert(path);
+    dirtyTimer_->start();
+}
+
+void LibraryComponent::rescanDirty()
+{
+    if (dirty_.isEmpty())
+        return;
+
+    QStringList const dirty = dirty_.toList();
+    dirty_.clear();
+    startScan(dirty);
+}
+
+void LibraryComponent::applyScanResult()
+{
+    ScanResult const result = scanWatcher_.result();
+    entries_ = result.entries;
+    directories_ = result.directories;
+
+    watchDirectories();
+    emit libraryChanged();
+    emit scanFinished(entries_.size(), scanTimer_.elapsed());
+
+    if (rescanRequested_)
+    {
+        rescanRequested_ = false;
+        rescan();
+    }
+    else if (!dirty_.isEmpty())
+        rescanDirty();
+}
+
+void LibraryComponent::startScan(const QStringList &dirty)
+{
+    if (scanWatcher_.isRunning())
+    {
+        if (dirty.isEmpty())
+            rescanRequested_ = true;
+        else
+            dirty_ += dirty.toSet();
+        return;
+    }
+
+    ScanResult previous;
+    previous.entries = entries_;
+    previous.directories = directories_;
+
+    scanTimer_.start();
+    scanWatcher_.setFuture(QtConcurrent::run(&scanPool_, scan, roots_, dirty, previous, indexFileName()));
+}
+
+void LibraryComponent::watchDirectories()
+{
+    QSet<QString> const watched = fileSystemWatcher_->directories().toSet();
+
+    QStringList const removed = (watched - directories_).toList();
+    if (!removed.isEmpty())
+        fileSystemWatcher_->removePaths(removed);
+
+    //! Directories that could not be watched, e.g. past max_user_watches,
+    //! come back here after every scan and are tried again
+    QStringList const added = (directories_ - watched).toList();
+    QStringList const failed = added.isEmpty() ? QStringList() : fileSystemWatcher_->addPaths(added);
+
+    //! Rewriting a file in place does not change its directory, so even a
+    //! fully watched library is walked now and then; only mtime and size
+    //! are compared, tags are read for changed files alone
+    if (roots_.isEmpty())
+        pollTimer_->stop();
+    else
+        pollTimer_->start(failed.isEmpty() ? POLL_INTERVAL : UNWATCHED_POLL_INTERVAL);
+}
+
+QString LibraryComponent::indexFileName() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::DataLocation) + "/library.index";
+}
@@ -0,0 +1,89 @@
+#ifndef LIBRARYCOMPONENT_H
+#define LIBRARYCOMPONENT_H
+
+#include "playlistmodel.h"
+
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+
+class QFileSystemWatcher;
+class QTimer;
+
+//! Local music collection: directories are walked and tagged in parallel,
+//! the result is kept in a compact on-disk index and rescans only read
+//! tags of files whose mtime or size changed. Directory watches catch new
+//! and removed files; a periodic walk catches files rewritten in place and
+//! directories the system refused to watch.
+class LibraryComponent : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Entry
+    {
+        QString path;
+        qint64 modified;
+        qint64 size;
+        QString artist;
+        QString title;
+        int duration;
+        int bitrate;
+
+        Entry() : modified(0), size(0), duration(0), bitrate(0) {}
+    };
+
+    typedef QHash<QString, Entry> Index;
+
+    struct ScanResult
+    {
+        Index entries;
+        QSet<QString> directories;
+    };
+
+    explicit LibraryComponent(QObject *parent = 0);
+    ~LibraryComponent();
+
+    QStringList directories() const;
+    PlaylistModel::Tracks tracks() const;
+    bool isScanning() const;
+
+signals:
+    void libraryChanged();
+    void scanFinished(int trackCount, qint64 elapsed);
+
+public slots:
+    void load();
+    void addDirectory(const QString& path);
+    void removeDirectory(const QString& path);
+    void rescan();
+
+private slots:
+    void markDirty(const QString& path);
+    void rescanDirty();
+    void applyScanResult();
+
+private:
+    void startScan(const QStringList& dirty);
+    void watchDirectories();
+    QString indexFileName() const;
+
+    QStringList roots_;
+    Index entries_;
+    QSet<QString> directories_;
+    QSet<QString> dirty_;
+    bool rescanRequested_;
+
+    QThreadPool scanPool_;
+    QElapsedTimer scanTimer_;
+    QFutureWatcher<ScanResult> scanWatcher_;
+    QFileSystemWatcher *fileSystemWatcher_;
+    QTimer *dirtyTimer_;
+    QTimer *pollTimer_;
+};
+
+#endif // LIBRARYCOMPONENT_H
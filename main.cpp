@@ -1,15 +1,89 @@
+#include "instanceguard.h"
 #include "mainwindow.h"
+#include "resourcemonitor.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QDesktopWidget>
 #include <QStyle>
 
+#include <cstdio>
+
+//! A relaunch without options only hands its command to the running
+//! instance, straight from argv and before any application object is built
+static bool forwardToRunningInstance(int argc, char *argv[])
+{
+    QStringList arguments;
+    for (int i = 1; i < argc; ++i)
+        arguments.append(QString::fromLocal8Bit(argv[i]));
+
+    foreach (const QString& argument, arguments)
+    {
+        if (argument.startsWith('-'))
+            return false;
+    }
+
+    QString const command = arguments.value(0, "show");
+    if (!InstanceGuard::isCommand(command))
+        return false;
+
+    return InstanceGuard::forward(command, QStringList(arguments.mid(1)).join(' '));
+}
+
 int main(int argc, char *argv[])
 {
+    if (forwardToRunningInstance(argc, argv))
+        return 0;
+
     QApplication a(argc, argv);
+    QApplication::setOrganizationName("Flow");
+    QApplication::setApplicationName("Flow");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument("command", "play, pause, play-pause, next, previous, show or search <text>; "
+                                 "sent to the running instance when there is one.", "[command [text]]");
+    QCommandLineOption dumpResourcesOption("dump-resources", "Print live resource counters on exit.");
+    QCommandLineOption apiBaseUrlOption("api-base-url", "Send API requests to <url> instead of api.vk.com.", "url");
+    parser.addOption(dumpResourcesOption);
+    parser.addOption(apiBaseUrlOption);
+    parser.process(a);
+
+    QStringList const positional = parser.positionalArguments();
+    if (!positional.isEmpty() && !InstanceGuard::isCommand(positional.first()))
+    {
+        std::fprintf(stderr, "flow: unknown command %s\n", qPrintable(positional.first()));
+        return 1;
+    }
+
+    //! An instance that started between the forward above and here owns
+    //! the socket now, so the command goes there instead
+    InstanceGuard guard;
+    if (!guard.listen())
+    {
+        QString const command = positional.value(0, "show");
+        if (InstanceGuard::forward(command, QStringList(positional.mid(1)).join(' ')))
+            return 0;
+
+        std::fprintf(stderr, "flow: cannot listen for commands from other instances\n");
+    }
+
     MainWindow w;
     setWidgetOnCenterScreen(&w);
     w.show();
 
-    return a.exec();
+    if (parser.isSet(apiBaseUrlOption))
+        w.setApiBaseUrl(QUrl(parser.value(apiBaseUrlOption)));
+
+    QObject::connect(&guard, &InstanceGuard::commandReceived, &w, &MainWindow::runCommand);
+
+    if (!positional.isEmpty())
+        w.runCommand(positional.first(), QStringList(positional.mid(1)).join(' '));
+
+    int const result = a.exec();
+
+    if (parser.isSet(dumpResourcesOption))
+        std::fprintf(stderr, "%s\n", qPrintable(ResourceMonitor::report()));
+
+    return result;
 }
@@ -2,8 +2,10 @@
 #include "ui_mainwindow.h"
 
 #include "apicomponent.h"
+#include "librarycomponent.h"
 #include "mediacomponent.h"
 #include "playerwidget.h"
+#include "urlresolver.h"
 
 #include <QApplication>
 #include <QDesktopWidget>
@@ -33,14 +35,18 @@ void setWidgetOnCenterScreen(QWidget *widget)
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow), authWeb_(new QWebEngineView()), api_(new ApiComponent(this)), media_(new MediaComponent(this)),
-    player_(new PlayerWidget(media_, api_))
+    library_(new LibraryComponent(this)), player_(new PlayerWidget(media_, api_, library_)),
+    signedIn_(false)
 {
     ui->setupUi(this);
 
+    library_->load();
+
     authWeb_->setAttribute(Qt::WA_DeleteOnClose);
 
     connect(api_, &ApiComponent::authorizeFinished, this, &MainWindow::processAuthResult);
-    connect(api_, &ApiComponent::playlistReceived, player_, &PlayerWidget::setPlaylist);
+
+    new UrlResolver(api_, media_, this);
 }
 
 MainWindow::~MainWindow()
@@ -48,6 +54,47 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
+ApiComponent *MainWindow::api() const
+{
+    return api_;
+}
+
+MediaComponent *MainWindow::media() const
+{
+    return media_;
+}
+
+PlayerWidget *MainWindow::player() const
+{
+    return player_;
+}
+
+void MainWindow::setApiBaseUrl(const QUrl &url)
+{
+    api_->setBaseUrl(url);
+}
+
+void MainWindow::runCommand(const QString &command, const QString &argument)
+{
+    if (signedIn_)
+    {
+        player_->runCommand(command, argument);
+        return;
+    }
+
+    if (command != "show")
+    {
+        pendingCommand_ = command;
+        pendingArgument_ = argument;
+    }
+
+    if (isVisible())
+    {
+        raise();
+        activateWindow();
+    }
+}
+
 void MainWindow::on_signInButton_clicked()
 {
     hide();
@@ -55,6 +102,7 @@ void MainWindow::on_signInButton_clicked()
     authWeb_->setWindowIcon(QIcon(":/icons/vkontakte.png"));
 
     connect(authWeb_, &QWebEngineView::urlChanged, api_, &ApiComponent::getTokensFromUrl);
+    api_->preconnect();
     authWeb_->load(QUrl("https://oauth.vk.com/authorize?client_id=" + APP_ID + "&scope=" + PERMISSIONS +
                         "&redirect_uri=" + REDIRECT_URI + "&display=" + DISPLAY + "&v=" + API_VERSION +
                         "&revoke=" + REVOKE + "&response_type=token"));
@@ -71,6 +119,13 @@ void MainWindow::processAuthResult(bool result, const QString &error)
         api_->requestAuthUserPlaylist();
         setWidgetOnCenterScreen(player_);
         player_->show();
+        signedIn_ = true;
+
+        if (!pendingCommand_.isEmpty())
+        {
+            player_->runCommand(pendingCommand_, pendingArgument_);
+            pendingCommand_.clear();
+        }
     }
     else
     {
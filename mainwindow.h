@@ -2,6 +2,7 @@
 #define MAINWINDOW_H
 
 #include "apicomponent.h"
+#include "librarycomponent.h"
 #include "playerwidget.h"
 #include "mediacomponent.h"
 
@@ -22,6 +23,16 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
+    ApiComponent * api() const;
+    MediaComponent * media() const;
+    PlayerWidget * player() const;
+
+    void setApiBaseUrl(const QUrl& url);
+
+public slots:
+    //! Commands forwarded by a relaunch; before sign-in they wait for it
+    void runCommand(const QString& command, const QString& argument);
+
 private slots:
     void on_signInButton_clicked();
     void processAuthResult(bool result, const QString& error);
@@ -32,7 +43,11 @@ private:
     QWebEngineView *authWeb_;
     ApiComponent *api_;
     MediaComponent *media_;
+    LibraryComponent *library_;
     PlayerWidget *player_;
+    bool signedIn_;
+    QString pendingCommand_;
+    QString pendingArgument_;
 };
 
 #endif // MAINWINDOW_H
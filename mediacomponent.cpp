@@ -1,21 +1,66 @@
 #include "mediacomponent.h"
+#include "coverartscanner.h"
+#include "resourcemonitor.h"
 
-#include <QTemporaryFile>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QNetworkAccessManager>
+#include <QTimer>
 
-#include <taglib/mpegfile.h>
-#include <taglib/id3v2tag.h>
-#include <taglib/attachedpictureframe.h>
+#include <algorithm>
+
+static const int SKIP_SETTLE_DELAY = 350;
+static const int FOREGROUND_NOTIFY_INTERVAL = 1000;
+static const int BACKGROUND_NOTIFY_INTERVAL = 5000;
+static const int ALBUM_ART_CACHE_BYTES = 8 * 1024 * 1024;
 
 MediaComponent::MediaComponent(QObject *parent) : QObject(parent), player_(new QMediaPlayer(this)),
-    playlist_(new QMediaPlaylist(this)), duration_(0), model_(new QStandardItemModel(this))
+    playlist_(new QMediaPlaylist(this)), networkManager_(new MonitoredNetworkAccessManager(this)),
+    albumArtReply_(0), albumArtCache_(ALBUM_ART_CACHE_BYTES), prefetcher_(new Prefetcher(networkManager_, this)),
+    background_(false), duration_(0), model_(new PlaylistModel(this)), waveform_(new WaveformComponent(networkManager_, this)),
+    bufferMonitor_(new BufferMonitor(player_, this)), downloads_(new DownloadManager(networkManager_, this)),
+    preRollTimer_(new QTimer(this)), preRollPending_(false), preRolling_(false), editingQueue_(false),
+    skipTimer_(new QTimer(this)), skipSteps_(0), skipTarget_(-1), skipping_(false), playbackMode_(QMediaPlaylist::Loop), shuffled_(false), shuffleOrderValid_(false)
 {
     player_->setPlaylist(playlist_);
+    player_->setNotifyInterval(FOREGROUND_NOTIFY_INTERVAL);
     setVolume(100);
+
     setPlaybackMode(QMediaPlaylist::Loop);
 
     connect(playlist_, SIGNAL(currentMediaChanged(QMediaContent)), this, SLOT(downloadAlbumArtFromMedia(QMediaContent)));
+    connect(playlist_, SIGNAL(currentMediaChanged(QMediaContent)), waveform_, SLOT(stop()));
     connect(player_, &QMediaPlayer::durationChanged, this, &MediaComponent::setDuration);
+    connect(playlist_, &QMediaPlaylist::mediaInserted, this, &MediaComponent::invalidateShuffleOrder);
+    connect(playlist_, &QMediaPlaylist::mediaRemoved, this, &MediaComponent::invalidateShuffleOrder);
+    connect(playlist_, &QMediaPlaylist::currentIndexChanged, this, &MediaComponent::advanceShuffledPlayback);
+
+    model_->setMovable(true);
+    connect(model_, &PlaylistModel::moveRequested, this, &MediaComponent::moveTracks);
+
+    preRollTimer_->setSingleShot(true);
+    connect(preRollTimer_, &QTimer::timeout, this, &MediaComponent::finishPreRoll);
+    connect(player_, &QMediaPlayer::currentMediaChanged, this, &MediaComponent::beginPreRoll);
+    connect(player_, &QMediaPlayer::mediaStatusChanged, this, &MediaComponent::holdForPreRoll);
+    connect(player_, &QMediaPlayer::stateChanged, this, &MediaComponent::holdForPreRoll);
+    connect(player_, &QMediaPlayer::stateChanged, this, &MediaComponent::forwardState);
+    connect(player_, &QMediaPlayer::mediaStatusChanged, this, &MediaComponent::updateDownloadThrottle);
+    connect(player_, &QMediaPlayer::currentMediaChanged, this, &MediaComponent::updateNotifyInterval);
+    connect(player_, &QMediaPlayer::positionChanged, this, &MediaComponent::updateNotifyInterval);
+
+    //! The real stream needs the bandwidth more than any guess does
+    connect(player_, &QMediaPlayer::currentMediaChanged, prefetcher_, &Prefetcher::cancel);
+    connect(prefetcher_, &Prefetcher::prefetched, this, &MediaComponent::cachePrefetched);
+    connect(player_, &QMediaPlayer::bufferStatusChanged, this, [this](int percent)
+    {
+        //! Holding any longer gains nothing once the backend buffer is full
+        if (preRolling_ && percent >= 100)
+            finishPreRoll();
+    });
+
+    skipTimer_->setSingleShot(true);
+    skipTimer_->setInterval(SKIP_SETTLE_DELAY);
+    connect(skipTimer_, &QTimer::timeout, this, &MediaComponent::commitSkip);
 }
 
 void MediaComponent::setPlayer(QMediaPlayer *player)
@@ -31,25 +76,185 @@ void MediaComponent::setPlaylist(QMediaPlaylist *playlist)
     player_->setPlaylist(playlist);
 }
 
-void MediaComponent::copyModel(QStandardItemModel *model)
+void MediaComponent::setTracks(const PlaylistModel::Tracks &tracks)
 {
-    Q_ASSERT(model);
+    QList<QMediaContent> const media = queueMedia(tracks);
 
-    model_->removeRows(0, model_->rowCount());
+    cancelSkip();
+    model_->setTracks(tracks);
+    playlist_->clear();
+    playlist_->addMedia(media);
+}
 
-    for (int i = 0 ; i < model->rowCount() ; i++)
-        for(int j = 0; j < model->columnCount(); ++j)
-            model_->setItem(i, j, model->item(i, j)->clone());
+void MediaComponent::appendTracks(const PlaylistModel::Tracks &tracks)
+{
+    insertTracks(playlist_->mediaCount(), tracks, false);
 }
 
-void MediaComponent::copyPlaylist(QMediaPlaylist *playlist)
+void MediaComponent::playNext(const PlaylistModel::Tracks &tracks)
 {
-    Q_ASSERT(playlist);
+    commitSkip();
+    insertTracks(playlist_->currentIndex() + 1, tracks, true);
+}
 
-    playlist_->clear();
+void MediaComponent::playNext(const QVector<int> &rows)
+{
+    //! Taken out and put back, which also puts them next in shuffle order
+    int const current = playlist_->currentIndex();
+    PlaylistModel::Tracks tracks;
+    QVector<int> moved;
+    foreach (int row, rows)
+    {
+        if (row >= 0 && row < model_->rowCount() && row != current && !moved.contains(row))
+        {
+            tracks.append(model_->track(row));
+            moved.append(row);
+        }
+    }
+
+    removeTracks(moved);
+    playNext(tracks);
+}
+
+void MediaComponent::removeTracks(const QVector<int> &rows)
+{
+    //! A pending skip lands first, its target is an index
+    commitSkip();
+
+    int const current = playlist_->currentIndex();
+    QVector<int> removed;
+    foreach (int row, rows)
+    {
+        if (row >= 0 && row < model_->rowCount() && row != current)
+            removed.append(row);
+    }
+    std::sort(removed.begin(), removed.end());
+    removed.erase(std::unique(removed.begin(), removed.end()), removed.end());
+
+    //! Runs from the bottom up, so the rows above keep their indexes
+    for (int last = removed.size() - 1; last >= 0; --last)
+    {
+        int first = last;
+        while (first > 0 && removed.at(first - 1) == removed.at(first) - 1)
+            --first;
+
+        removeRun(removed.at(first), last - first + 1);
+        last = first;
+    }
+}
+
+void MediaComponent::moveTracks(const QVector<int> &rows, int destination)
+{
+    commitSkip();
+
+    QVector<int> moved;
+    foreach (int row, rows)
+    {
+        if (row >= 0 && row < model_->rowCount())
+            moved.append(row);
+    }
+    std::sort(moved.begin(), moved.end());
+    moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+
+    int const split = std::lower_bound(moved.begin(), moved.end(), destination) - moved.begin();
+
+    //! Runs above the destination stack up in front of it from the closest
+    //! one, runs below it line up after them; every run moves once and the
+    //! rows still to move keep their indexes
+    int at = destination;
+    for (int last = split - 1; last >= 0; --last)
+    {
+        int first = last;
+        while (first > 0 && moved.at(first - 1) == moved.at(first) - 1)
+            --first;
+
+        int const count = last - first + 1;
+        moveRun(moved.at(first), count, at);
+        at -= count;
+        last = first;
+    }
+
+    at = destination;
+    for (int first = split; first < moved.size(); ++first)
+    {
+        int last = first;
+        while (last + 1 < moved.size() && moved.at(last + 1) == moved.at(last) + 1)
+            ++last;
+
+        int const count = last - first + 1;
+        moveRun(moved.at(first), count, at);
+        at += count;
+        first = last;
+    }
+}
+
+void MediaComponent::refreshUrls(const PlaylistModel::Tracks &tracks)
+{
+    QHash<QString, PlaylistModel::Track> resolved;
+    foreach (const PlaylistModel::Track& track, tracks)
+    {
+        if (!track.id.isEmpty())
+            resolved.insert(track.id, track);
+    }
+
+    int const current = playlist_->currentIndex();
+    bool const failed = player_->error() != QMediaPlayer::NoError;
+    int const count = qMin(model_->rowCount(), playlist_->mediaCount());
+
+    //! Same track at the same index: the shuffle order and the current
+    //! index are left alone while the media is swapped
+    editingQueue_ = true;
+    bool restart = false;
 
-    for (int i = 0; i < playlist->mediaCount(); ++i)
-        playlist_->addMedia(playlist->media(i));
+    for (int row = 0; row < count; ++row)
+    {
+        QHash<QString, PlaylistModel::Track>::const_iterator const fresh = resolved.constFind(model_->track(row).id);
+        if (fresh == resolved.constEnd() || url(row).isLocalFile())
+            continue;
+
+        if (fresh->url == model_->track(row).url)
+        {
+            model_->setTrackUrl(row, fresh->url, fresh->signedAt);
+            continue;
+        }
+
+        if (row == current && !failed)
+            continue;
+
+        model_->setTrackUrl(row, fresh->url, fresh->signedAt);
+        playlist_->insertMedia(row + 1, QMediaContent(fresh->url));
+        playlist_->removeMedia(row);
+        restart = restart || row == current;
+    }
+
+    editingQueue_ = false;
+
+    if (restart)
+        playIndex(current);
+}
+
+void MediaComponent::setBackground(bool background)
+{
+    if (background_ == background)
+        return;
+
+    background_ = background;
+    updateNotifyInterval();
+
+    if (background_)
+    {
+        waveform_->stop();
+        return;
+    }
+
+    QMediaContent const media = playlist_->currentMedia();
+    if (media.isNull() || albumArtUrl_ != media.canonicalUrl())
+        downloadAlbumArtFromMedia(media);
+    else if (!albumArtReply_)
+        publishAlbumArt();
+
+    if (player_->duration() > 0)
+        waveform_->analyze(media.canonicalUrl(), player_->duration());
 }
 
 QMediaPlayer*  MediaComponent::player() const
@@ -62,11 +267,31 @@ QMediaPlaylist* MediaComponent::playlist() const
     return playlist_;
 }
 
-QStandardItemModel *MediaComponent::model() const
+PlaylistModel *MediaComponent::model() const
 {
     return model_;
 }
 
+QNetworkAccessManager *MediaComponent::networkManager() const
+{
+    return networkManager_;
+}
+
+WaveformComponent *MediaComponent::waveform() const
+{
+    return waveform_;
+}
+
+BufferMonitor *MediaComponent::bufferMonitor() const
+{
+    return bufferMonitor_;
+}
+
+DownloadManager *MediaComponent::downloads() const
+{
+    return downloads_;
+}
+
 qint64 MediaComponent::duration() const
 {
     return duration_;
@@ -79,7 +304,61 @@ QUrl MediaComponent::url(int index) const
 
 QMediaPlayer::State MediaComponent::state() const
 {
-    return player_->state();
+    return preRolling_ ? QMediaPlayer::PlayingState : player_->state();
+}
+
+bool MediaComponent::isEditingQueue() const
+{
+    return editingQueue_;
+}
+
+bool MediaComponent::isShuffled() const
+{
+    return shuffled_;
+}
+
+QVector<int> MediaComponent::upcomingIndexes(int count)
+{
+    int const mediaCount = playlist_->mediaCount();
+    int const current = playlist_->currentIndex();
+    QVector<int> indexes;
+
+    if (shuffled_ && playbackMode_ != QMediaPlaylist::CurrentItemInLoop)
+    {
+        ensureShuffleOrder();
+        indexes = shuffleOrder_.upcoming(count);
+        if (playbackMode_ != QMediaPlaylist::Loop)
+            indexes.resize(qMin(indexes.size(), shuffleOrder_.remaining()));
+        return indexes;
+    }
+
+    switch (playbackMode_) {
+    case QMediaPlaylist::CurrentItemInLoop:
+        if (current >= 0 && count > 0)
+            indexes.append(current);
+        break;
+    case QMediaPlaylist::Loop:
+        for (int i = 1; i <= count && i < mediaCount; ++i)
+            indexes.append((qMax(current, 0) + i) % mediaCount);
+        break;
+    default:
+        for (int i = current + 1; i < mediaCount && indexes.size() < count; ++i)
+            indexes.append(i);
+        break;
+    }
+
+    return indexes;
+}
+
+int MediaComponent::remainingCount()
+{
+    if (shuffled_ && playbackMode_ != QMediaPlaylist::CurrentItemInLoop)
+    {
+        ensureShuffleOrder();
+        return shuffleOrder_.remaining();
+    }
+
+    return playlist_->mediaCount() - 1 - playlist_->currentIndex();
 }
 
 MediaComponent::~MediaComponent()
@@ -88,33 +367,52 @@ MediaComponent::~MediaComponent()
 
 void MediaComponent::play()
 {
-    player_->play();
+    if (preRolling_)
+        finishPreRoll();
+    else
+        player_->play();
 }
 
 void MediaComponent::playIndex(int index)
 {
+    cancelSkip();
+
+    if (shuffled_)
+    {
+        ensureShuffleOrder();
+        shuffleOrder_.moveTo(index);
+    }
+
     playlist_->setCurrentIndex(index);
     play();
 }
 
 void MediaComponent::stop()
 {
+    cancelPreRoll();
     player_->stop();
 }
 
 void MediaComponent::pause()
 {
+    if (preRolling_)
+    {
+        cancelPreRoll();
+        emit stateChanged(QMediaPlayer::PausedState);
+        return;
+    }
+
     player_->pause();
 }
 
 void MediaComponent::next()
 {
-    playlist_->next();
+    skip(1);
 }
 
 void MediaComponent::previous()
 {
-    playlist_->previous();
+    skip(-1);
 }
 
 void MediaComponent::setVolume(int volume)
@@ -129,7 +427,15 @@ void MediaComponent::setPosition(int position)
 
 void MediaComponent::setPlaybackMode(QMediaPlaylist::PlaybackMode mode)
 {
-    playlist_->setPlaybackMode(mode);
+    playbackMode_ = mode;
+    applyPlaybackMode();
+}
+
+void MediaComponent::setShuffled(bool shuffled)
+{
+    shuffled_ = shuffled;
+    shuffleOrderValid_ = false;
+    applyPlaybackMode();
 }
 
 void MediaComponent::addItemToPlaylist(const QUrl &url)
@@ -145,52 +451,372 @@ void MediaComponent::clearPlaylist()
 void MediaComponent::setDuration(qint64 duration)
 {
     duration_ = duration / 1000;
+
+    if (duration > 0 && !background_)
+        waveform_->analyze(playlist_->currentMedia().canonicalUrl(), duration);
 }
 
 void MediaComponent::downloadAlbumArtFromMedia(QMediaContent media)
 {
-    QNetworkAccessManager *networkManager = new QNetworkAccessManager(this);
-    connect(networkManager, &QNetworkAccessManager::finished, this, &MediaComponent::extractAlbumArtFromMedia);
-    QNetworkRequest networkRequest(media.canonicalUrl());
-    QNetworkReply *reply = networkManager->get(networkRequest);
+    //! Only the art of the track that is loaded now is of any use
+    if (albumArtReply_)
+    {
+        QNetworkReply * const stale = albumArtReply_;
+        albumArtReply_ = 0;
+        stale->abort();
+    }
+
+    albumArtUrl_.clear();
+    albumArtData_.clear();
+
+    if (media.isNull() || background_)
+        return;
+
+    albumArtUrl_ = media.canonicalUrl();
+
+    if (AlbumArt const * const cached = albumArtCache_.object(albumArtKey(albumArtUrl_)))
+    {
+        albumArtData_ = cached->data;
+        albumArtFormat_ = cached->format;
+        publishAlbumArt();
+        return;
+    }
+
+    QNetworkRequest networkRequest(albumArtUrl_);
+    QNetworkReply *reply = networkManager_->get(networkRequest);
+    albumArtReply_ = reply;
+    QElapsedTimer transferTimer;
+    transferTimer.start();
+    connect(reply, &QNetworkReply::finished, this, [this, reply, transferTimer]()
+    {
+        if (reply != albumArtReply_)
+        {
+            reply->deleteLater();
+            return;
+        }
+
+        albumArtReply_ = 0;
+
+        //! The whole file comes through here, which makes a fair throughput sample
+        if (reply->error() == QNetworkReply::NoError)
+            bufferMonitor_->addThroughputSample(reply->url().host(), reply->bytesAvailable(), transferTimer.elapsed());
+
+        extractAlbumArtFromMedia(reply);
+    });
 }
 
 void MediaComponent::extractAlbumArtFromMedia(QNetworkReply *reply)
 {
-    emit albumArtExtracted(QPixmap());
+    if (!background_)
+        emit albumArtExtracted(QPixmap());
 
-    QTemporaryFile mediaFile;
-    if (mediaFile.open())
+    AlbumArt albumArt;
+    if (readAlbumArt(reply->readAll(), albumArt))
     {
-        mediaFile.write(reply->readAll());
-        mediaFile.flush();
-        mediaFile.close();
-        TagLib::MPEG::File file(mediaFile.fileName().toStdString().c_str());
+        //! Only the encoded picture is kept; it is decoded on demand
+        albumArtData_ = albumArt.data;
+        albumArtFormat_ = albumArt.format;
+        albumArtCache_.insert(albumArtKey(albumArtUrl_), new AlbumArt(albumArt), albumArt.data.size());
 
-        TagLib::ID3v2::Tag *tag = file.ID3v2Tag();
-        if(tag)
-        {
-            TagLib::ID3v2::FrameList frames = tag->frameListMap()["APIC"];
-            if(!frames.isEmpty())
-            {
-                TagLib::ID3v2::AttachedPictureFrame *pictureFrame = static_cast<TagLib::ID3v2::AttachedPictureFrame*>(frames.front());
-
-                if (pictureFrame)
-                {
-                    std::string format;
-                    TagLib::String const mimeType = pictureFrame->mimeType();
-                    if (mimeType == "image/jpeg")
-                        format = "JPEG";
-                    else if (mimeType == "image/png")
-                        format = "PNG";
-                    if(!format.empty())
-                    {
-                        QPixmap albumArtPixmap;
-                        albumArtPixmap.loadFromData((uchar*)pictureFrame->picture().data(), pictureFrame->picture().size(), format.c_str());
-                        emit albumArtExtracted(albumArtPixmap);
-                    }
-                }
-            }
-        }
+        if (!background_)
+            publishAlbumArt();
+    }
+
+    reply->deleteLater();
+}
+
+void MediaComponent::prefetch(const QUrl &url)
+{
+    QMediaPlayer::MediaStatus const status = player_->mediaStatus();
+    bool const filling = status == QMediaPlayer::LoadingMedia || status == QMediaPlayer::BufferingMedia ||
+            status == QMediaPlayer::StalledMedia || preRolling_;
+
+    if (background_ || filling || url.isLocalFile() || downloads_->isAvailable(url) ||
+            url == player_->currentMedia().canonicalUrl())
+    {
+        prefetcher_->cancel();
+        return;
+    }
+
+    prefetcher_->prefetch(url);
+}
+
+void MediaComponent::cachePrefetched(const QUrl &url, const QByteArray &head, qint64 elapsed)
+{
+    bufferMonitor_->addThroughputSample(url.host(), head.size(), elapsed);
+
+    //! The head is the ID3 tag, up to the chunk size
+    AlbumArt albumArt;
+    if (readAlbumArt(head, albumArt))
+        albumArtCache_.insert(albumArtKey(url), new AlbumArt(albumArt), albumArt.data.size());
+}
+
+void MediaComponent::updateNotifyInterval()
+{
+    //! Startup time is measured on the first position tick, so a new track
+    //! still gets fine ticks until it is audible
+    bool const sparse = background_ && player_->position() > 0;
+    int const interval = sparse ? BACKGROUND_NOTIFY_INTERVAL : FOREGROUND_NOTIFY_INTERVAL;
+    if (player_->notifyInterval() != interval)
+        player_->setNotifyInterval(interval);
+}
+
+void MediaComponent::beginPreRoll()
+{
+    //! A track change while holding hands playback over to the new track
+    if (preRolling_)
+    {
+        cancelPreRoll();
+        player_->play();
+    }
+
+    preRollPending_ = true;
+    holdForPreRoll();
+}
+
+void MediaComponent::holdForPreRoll()
+{
+    if (!preRollPending_ || player_->state() != QMediaPlayer::PlayingState)
+        return;
+
+    preRollPending_ = false;
+
+    QUrl const url = player_->currentMedia().canonicalUrl();
+    int const index = playlist_->currentIndex();
+    int bitrate = 0, duration = 0;
+    if (index >= 0 && index < model_->rowCount())
+    {
+        bitrate = model_->track(index).bitrate;
+        duration = model_->track(index).duration;
+    }
+
+    qint64 const preRoll = url.isLocalFile() ? 0 : bufferMonitor_->preRollTime(url.host(), bitrate, duration);
+    bufferMonitor_->setPreRoll(preRoll);
+    if (preRoll <= 0)
+        return;
+
+    //! The backend keeps filling its buffer while paused
+    preRolling_ = true;
+    preRollTimer_->start(preRoll);
+    player_->pause();
+    updateDownloadThrottle();
+}
+
+void MediaComponent::finishPreRoll()
+{
+    if (!preRolling_)
+        return;
+
+    cancelPreRoll();
+    player_->play();
+}
+
+void MediaComponent::forwardState(QMediaPlayer::State state)
+{
+    if (preRolling_ && state == QMediaPlayer::PausedState)
+        return;
+
+    emit stateChanged(state);
+}
+
+void MediaComponent::updateDownloadThrottle()
+{
+    //! Offline downloads and the waveform analysis back off while the
+    //! playing stream is filling its buffer
+    QMediaPlayer::MediaStatus const status = player_->mediaStatus();
+    bool const filling = status == QMediaPlayer::LoadingMedia || status == QMediaPlayer::BufferingMedia ||
+            status == QMediaPlayer::StalledMedia || preRolling_;
+    bool const throttled = filling && !player_->currentMedia().canonicalUrl().isLocalFile();
+    downloads_->setThrottled(throttled);
+    waveform_->setThrottled(throttled);
+}
+
+void MediaComponent::invalidateShuffleOrder()
+{
+    if (!editingQueue_)
+        shuffleOrderValid_ = false;
+}
+
+void MediaComponent::advanceShuffledPlayback(int index)
+{
+    //! In shuffle mode the playlist runs in CurrentItemOnce, so reaching the
+    //! end of a track leaves it without a current item; continue from here
+    if (!shuffled_ || index != -1 || playlist_->isEmpty() || playbackMode_ == QMediaPlaylist::CurrentItemInLoop)
+        return;
+
+    if (player_->mediaStatus() != QMediaPlayer::EndOfMedia)
+        return;
+
+    ensureShuffleOrder();
+    if (playbackMode_ == QMediaPlaylist::Sequential && shuffleOrder_.atEnd())
+        return;
+
+    QMetaObject::invokeMethod(this, "playIndex", Qt::QueuedConnection, Q_ARG(int, shuffleOrder_.next()));
+}
+
+void MediaComponent::commitSkip()
+{
+    if (!skipping_)
+        return;
+
+    int const target = skipTarget_;
+    cancelSkip();
+    playlist_->setCurrentIndex(target);
+}
+
+void MediaComponent::applyPlaybackMode()
+{
+    if (shuffled_ && playbackMode_ != QMediaPlaylist::CurrentItemInLoop)
+        playlist_->setPlaybackMode(QMediaPlaylist::CurrentItemOnce);
+    else
+        playlist_->setPlaybackMode(playbackMode_);
+}
+
+void MediaComponent::cancelPreRoll()
+{
+    preRolling_ = false;
+    preRollTimer_->stop();
+    updateDownloadThrottle();
+}
+
+void MediaComponent::skip(int steps)
+{
+    //! Presses in a burst only move the target; the stream, the album art
+    //! and everything else hanging off the current index follow once, at
+    //! commit. Skipping back to where it started loads nothing at all.
+    if (shuffled_ && playbackMode_ != QMediaPlaylist::CurrentItemInLoop)
+    {
+        ensureShuffleOrder();
+        skipTarget_ = steps > 0 ? shuffleOrder_.next() : shuffleOrder_.previous();
+    }
+    else
+    {
+        skipSteps_ += steps;
+        if (skipSteps_ > 0)
+            skipTarget_ = playlist_->nextIndex(skipSteps_);
+        else if (skipSteps_ < 0)
+            skipTarget_ = playlist_->previousIndex(-skipSteps_);
+        else
+            skipTarget_ = playlist_->currentIndex();
+    }
+
+    skipping_ = true;
+    skipTimer_->start();
+    emit skipPending(skipTarget_);
+}
+
+void MediaComponent::cancelSkip()
+{
+    skipTimer_->stop();
+    skipping_ = false;
+    skipSteps_ = 0;
+    skipTarget_ = -1;
+}
+
+QList<QMediaContent> MediaComponent::queueMedia(const PlaylistModel::Tracks &tracks) const
+{
+    QList<QMediaContent> media;
+    media.reserve(tracks.size());
+    foreach (const PlaylistModel::Track& track, tracks)
+        media.append(QMediaContent(downloads_->localUrl(track.url)));
+
+    return media;
+}
+
+void MediaComponent::insertTracks(int index, const PlaylistModel::Tracks &tracks, bool next)
+{
+    if (tracks.isEmpty())
+        return;
+
+    model_->insertTracks(index, tracks);
+
+    editingQueue_ = true;
+    playlist_->insertMedia(index, queueMedia(tracks));
+    editingQueue_ = false;
+
+    if (shuffleOrderValid_)
+        shuffleOrder_.insert(index, tracks.size(), next);
+}
+
+void MediaComponent::removeRun(int first, int count)
+{
+    model_->removeTracks(first, count);
+
+    editingQueue_ = true;
+    playlist_->removeMedia(first, first + count - 1);
+    editingQueue_ = false;
+
+    if (shuffleOrderValid_)
+        shuffleOrder_.remove(first, count);
+}
+
+void MediaComponent::moveRun(int first, int count, int destination)
+{
+    if (count <= 0 || (destination >= first && destination <= first + count))
+        return;
+
+    //! The playing media must stay in the playlist, so the rows on the other
+    //! side of it move instead; the resulting order is the same
+    int const current = playlist_->currentIndex();
+    if (current >= first && current < first + count)
+    {
+        if (destination > first)
+            moveRun(first + count, destination - first - count, first);
+        else
+            moveRun(destination, first - destination, first + count);
+        return;
+    }
+
+    QList<QMediaContent> media;
+    media.reserve(count);
+    for (int i = first; i < first + count; ++i)
+        media.append(playlist_->media(i));
+
+    model_->moveTracks(first, count, destination);
+
+    //! Qt 5.4 playlists cannot move media, but these are pointer-sized
+    //! list shifts, not a rebuild
+    editingQueue_ = true;
+    playlist_->removeMedia(first, first + count - 1);
+    playlist_->insertMedia(destination > first ? destination - count : destination, media);
+    editingQueue_ = false;
+
+    if (shuffleOrderValid_)
+        shuffleOrder_.move(first, count, destination);
+}
+
+void MediaComponent::publishAlbumArt()
+{
+    QPixmap albumArt;
+    if (!albumArtData_.isEmpty())
+        albumArt.loadFromData(albumArtData_, albumArtFormat_.constData());
+
+    emit albumArtExtracted(albumArt);
+}
+
+bool MediaComponent::readAlbumArt(const QByteArray &media, AlbumArt &albumArt)
+{
+    CoverArtScanner::Picture picture;
+    if (!CoverArtScanner::scan(media, picture))
+        return false;
+
+    //! The one copy made: the picture outlives the downloaded file
+    albumArt.data = picture.decoded.isEmpty() ? QByteArray(picture.data, picture.size)
+                                              : picture.decoded.mid(picture.data - picture.decoded.constData(), picture.size);
+    albumArt.format = picture.format;
+    return true;
+}
+
+QString MediaComponent::albumArtKey(const QUrl &url)
+{
+    return PlaylistModel::streamKey(url);
+}
+
+void MediaComponent::ensureShuffleOrder()
+{
+    if (!shuffleOrderValid_)
+    {
+        shuffleOrder_.reset(playlist_->mediaCount(), playlist_->currentIndex());
+        shuffleOrderValid_ = true;
     }
 }
@@ -1,11 +1,20 @@
 #ifndef MEDIACOMPONENT_H
 #define MEDIACOMPONENT_H
 
+#include "buffermonitor.h"
+#include "downloadmanager.h"
+#include "prefetcher.h"
+#include "playlistmodel.h"
+#include "shuffleorder.h"
+#include "waveformcomponent.h"
+
+#include <QCache>
 #include <QObject>
 #include <QMediaPlayer>
 #include <QMediaPlaylist>
 #include <QNetworkReply>
-#include <QStandardItemModel>
+
+class QTimer;
 
 class MediaComponent : public QObject
 {
@@ -16,17 +25,49 @@ public:
     void setPlayer(QMediaPlayer *player);
     void setPlaylist(QMediaPlaylist *playlist);
 
-    void copyModel(QStandardItemModel *model);
-    void copyPlaylist(QMediaPlaylist *playlist);
+    void setTracks(const PlaylistModel::Tracks& tracks);
+    //! Extends the queue in place; the current track and the shuffle
+    //! order of the queued tracks are kept
+    void appendTracks(const PlaylistModel::Tracks& tracks);
+    //! The tracks go right after the current one, in shuffle order too
+    void playNext(const PlaylistModel::Tracks& tracks);
+    //! Queued rows jump up to play after the current one
+    void playNext(const QVector<int>& rows);
+    //! The playing track is never removed or taken out of the playlist, so
+    //! queue edits leave the stream alone
+    void removeTracks(const QVector<int>& rows);
+    void moveTracks(const QVector<int>& rows, int destination);
+    //! Swaps in re-signed urls for queued tracks with the same ids. The
+    //! playing track is only replaced, and restarted, after it failed.
+    void refreshUrls(const PlaylistModel::Tracks& tracks);
+
+    //! With no window to show them, position ticks are sparse and album
+    //! art and waveforms are neither fetched nor decoded; leaving the
+    //! background publishes them for the current track again
+    void setBackground(bool background);
 
     QMediaPlayer * player() const;
     QMediaPlaylist * playlist() const;
-    QStandardItemModel * model() const;
+    PlaylistModel * model() const;
+    QNetworkAccessManager * networkManager() const;
+    WaveformComponent * waveform() const;
+    BufferMonitor * bufferMonitor() const;
+    DownloadManager * downloads() const;
 
     qint64 duration() const;
 
     QUrl url(int index) const;
 
+    //! Index changes while the queue is edited in place are shifts, not
+    //! track changes
+    bool isEditingQueue() const;
+
+    bool isShuffled() const;
+    QVector<int> upcomingIndexes(int count);
+    //! Tracks left before the queue ends or starts over
+    int remainingCount();
+
+    //! Holding a track for its pre-roll counts as playing
     QMediaPlayer::State state() const;
 
     ~MediaComponent();
@@ -44,12 +85,21 @@ public slots:
     void setVolume(int volume);
     void setPosition(int position);
     void setPlaybackMode(QMediaPlaylist::PlaybackMode mode);
+    void setShuffled(bool shuffled);
+
+    //! ID3 tag and cover of a track the user is likely to pick next; skipped
+    //! while the playing stream is still filling its buffer
+    void prefetch(const QUrl& url);
 
     void addItemToPlaylist(const QUrl& url);
     void clearPlaylist();
 
 signals:
     void albumArtExtracted(const QPixmap&);
+    void stateChanged(QMediaPlayer::State state);
+    //! Index a burst of next/previous presses is heading for; the playlist
+    //! only moves there once the presses settle
+    void skipPending(int index);
 
 private slots:
     void setDuration(qint64 duration);
@@ -58,12 +108,68 @@ private slots:
 
     void extractAlbumArtFromMedia(QNetworkReply *);
 
+    void updateNotifyInterval();
+
+    void cachePrefetched(const QUrl& url, const QByteArray& head, qint64 elapsed);
+
+    void beginPreRoll();
+    void holdForPreRoll();
+    void finishPreRoll();
+    void forwardState(QMediaPlayer::State state);
+    void updateDownloadThrottle();
+
+    void invalidateShuffleOrder();
+    void advanceShuffledPlayback(int index);
+
+    void commitSkip();
+
 private:
+    struct AlbumArt
+    {
+        QByteArray data;
+        QByteArray format;
+    };
+
+    void applyPlaybackMode();
+    void ensureShuffleOrder();
+    void cancelPreRoll();
+    void skip(int steps);
+    void cancelSkip();
+    QList<QMediaContent> queueMedia(const PlaylistModel::Tracks& tracks) const;
+    void insertTracks(int index, const PlaylistModel::Tracks& tracks, bool next);
+    void removeRun(int first, int count);
+    void moveRun(int first, int count, int destination);
+    void publishAlbumArt();
+    static bool readAlbumArt(const QByteArray& media, AlbumArt& albumArt);
+    static QString albumArtKey(const QUrl& url);
 
     QMediaPlayer *player_;
     QMediaPlaylist *playlist_;
+    QNetworkAccessManager *networkManager_;
+    QNetworkReply *albumArtReply_;
+    QUrl albumArtUrl_;
+    QByteArray albumArtData_;
+    QByteArray albumArtFormat_;
+    QCache<QString, AlbumArt> albumArtCache_;
+    Prefetcher *prefetcher_;
+    bool background_;
     qint64 duration_;
-    QStandardItemModel *model_;
+    PlaylistModel *model_;
+    WaveformComponent *waveform_;
+    BufferMonitor *bufferMonitor_;
+    DownloadManager *downloads_;
+    QTimer *preRollTimer_;
+    bool preRollPending_;
+    bool preRolling_;
+    bool editingQueue_;
+    QTimer *skipTimer_;
+    int skipSteps_;
+    int skipTarget_;
+    bool skipping_;
+    QMediaPlaylist::PlaybackMode playbackMode_;
+    ShuffleOrder shuffleOrder_;
+    bool shuffled_;
+    bool shuffleOrderValid_;
 };
 
 #endif // MEDIACOMPONENT_H
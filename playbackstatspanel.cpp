@@ -0,0 +1,74 @@
+#include "playbackstatspanel.h"
+#include "buffermonitor.h"
+
+#include <QHeaderView>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+static QString formatTime(qint64 milliseconds)
+{
+    return milliseconds >= 0 ? QString::number(milliseconds) + " ms" : QString("-");
+}
+
+PlaybackStatsPanel::PlaybackStatsPanel(BufferMonitor *monitor, QWidget *parent) : QWidget(parent),
+    monitor_(monitor), hostsTree_(new QTreeWidget(this)), tracksTree_(new QTreeWidget(this))
+{
+    Q_ASSERT(monitor);
+
+    setWindowTitle("Flow Playback");
+    setWindowFlags(Qt::Tool);
+    setWindowIcon(QIcon(":icons/logo.png"));
+    resize(640, 420);
+
+    hostsTree_->setRootIsDecorated(false);
+    hostsTree_->setHeaderLabels(QStringList() << "Host" << "Tracks" << "Stalls" << "Stalled" << "Avg start-up" << "Throughput");
+    hostsTree_->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+    tracksTree_->setRootIsDecorated(false);
+    tracksTree_->setHeaderLabels(QStringList() << "Track" << "Start-up" << "Buffer" << "Pre-roll" << "Stalls" << "Stalled");
+    tracksTree_->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(hostsTree_);
+    layout->addWidget(tracksTree_, 2);
+
+    connect(monitor_, &BufferMonitor::statsChanged, this, &PlaybackStatsPanel::refresh);
+}
+
+void PlaybackStatsPanel::showEvent(QShowEvent *event)
+{
+    refresh();
+    QWidget::showEvent(event);
+}
+
+void PlaybackStatsPanel::refresh()
+{
+    if (!isVisible())
+        return;
+
+    hostsTree_->clear();
+    QHash<QString, BufferMonitor::HostStats> const hosts = monitor_->hosts();
+    for (QHash<QString, BufferMonitor::HostStats>::const_iterator it = hosts.constBegin(); it != hosts.constEnd(); ++it)
+    {
+        QTreeWidgetItem *item = new QTreeWidgetItem(hostsTree_);
+        item->setText(0, it.key().isEmpty() ? QString("(local)") : it.key());
+        item->setText(1, QString::number(it->tracks));
+        item->setText(2, QString::number(it->stalls));
+        item->setText(3, formatTime(it->stalledTime));
+        item->setText(4, it->tracks > 0 ? formatTime(it->startupTime / it->tracks) : QString("-"));
+        item->setText(5, it->throughput > 0.0 ? QString::number(qRound(it->throughput)) + " kbps" : QString("-"));
+    }
+
+    tracksTree_->clear();
+    foreach (const BufferMonitor::TrackStats& track, monitor_->recentTracks())
+    {
+        QTreeWidgetItem *item = new QTreeWidgetItem(tracksTree_);
+        item->setText(0, track.url.fileName());
+        item->setToolTip(0, track.url.toString(QUrl::RemoveQuery));
+        item->setText(1, formatTime(track.startupTime));
+        item->setText(2, QString::number(track.bufferAtStart) + "%");
+        item->setText(3, formatTime(track.preRoll));
+        item->setText(4, QString::number(track.stalls));
+        item->setText(5, formatTime(track.stalledTime));
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef PLAYBACKSTATSPANEL_H
+#define PLAYBACKSTATSPANEL_H
+
+#include <QWidget>
+
+class BufferMonitor;
+class QTreeWidget;
+
+//! Debug window with start-up and rebuffering statistics per CDN host and
+//! for the most recent tracks
+class PlaybackStatsPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PlaybackStatsPanel(BufferMonitor *monitor, QWidget *parent = 0);
+
+protected:
+    void showEvent(QShowEvent *event);
+
+private slots:
+    void refresh();
+
+private:
+    BufferMonitor *monitor_;
+    QTreeWidget *hostsTree_;
+    QTreeWidget *tracksTree_;
+};
+
+#endif // PLAYBACKSTATSPANEL_H
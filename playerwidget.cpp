@@ -1,26 +1,167 @@
 #include "playerwidget.h"
 #include "ui_playerwidget.h"
 
+#include "playbackstatspanel.h"
+#include "playlistitemdelegate.h"
+#include "radiomode.h"
+#include "resourcemonitor.h"
+#include "resourcepanel.h"
+#include "spectrumanalyzer.h"
+
 #include <QDesktopWidget>
 #include <QFileDialog>
+#include <QActionGroup>
 #include <QButtonGroup>
 #include <QMenu>
 #include <QMessageBox>
 #include <QMediaPlaylist>
-#include <QTextDocument>
+#include <QPainter>
+#include <QScrollBar>
+#include <QSettings>
+#include <QShortcut>
+#include <QTimer>
+#include <QVBoxLayout>
+
+#include <algorithm>
 
 static const int SYSTEM_TRAY_MESSAGE_TIMEOUT_HINT = 3000;
+static const int PROBE_SETTLE_DELAY = 150;
+static const int PREFETCH_SETTLE_DELAY = 400;
+static const int PLAYLIST_REFRESH_INTERVAL = 5 * 60 * 1000;
 static const QSize ALBUM_ART_SIZE(512, 512);
+static const QColor WAVEFORM_PLAYED_COLOR(120, 120, 120);
+static const QColor WAVEFORM_REMAINING_COLOR(190, 190, 190);
+static const QColor SPECTRUM_BAR_COLOR(255, 255, 255, 170);
+static const int SPECTRUM_BAR_SPACING = 2;
+
+void WaveformSlider::setPeaks(const WaveformComponent::Peaks &peaks)
+{
+    peaks_ = peaks;
+    renderWaveform();
+    update();
+}
+
+void WaveformSlider::paintEvent(QPaintEvent *event)
+{
+    if (!peaks_.isEmpty())
+    {
+        QPainter painter(this);
+        int const progress = QStyle::sliderPositionFromValue(minimum(), maximum(), value(), width());
+        painter.drawPixmap(0, 0, playedPixmap_, 0, 0, progress, height());
+        painter.drawPixmap(progress, 0, remainingPixmap_, progress, 0, width() - progress, height());
+    }
+
+    MouseDirectJumpSlider::paintEvent(event);
+}
+
+void WaveformSlider::resizeEvent(QResizeEvent *event)
+{
+    renderWaveform();
+    MouseDirectJumpSlider::resizeEvent(event);
+}
+
+void WaveformSlider::renderWaveform()
+{
+    countImages(-1);
+
+    if (peaks_.isEmpty())
+    {
+        playedPixmap_ = QPixmap();
+        remainingPixmap_ = QPixmap();
+        return;
+    }
+
+    int const w = width();
+    int const h = height();
+    qreal const middle = h / 2.0;
+
+    //! Render the envelope once per update so that position ticks only blit
+    QPixmap envelope(size());
+    envelope.fill(Qt::transparent);
+    {
+        QPainter painter(&envelope);
+        painter.setPen(Qt::black);
+
+        for (int x = 0; x < w; ++x)
+        {
+            int const first = x * WaveformComponent::BUCKET_COUNT / w;
+            int const last = qMax(first + 1, (x + 1) * WaveformComponent::BUCKET_COUNT / w);
+            if (first >= peaks_.filled)
+                break;
+
+            float lo = 0.0f;
+            float hi = 0.0f;
+            for (int bucket = first; bucket < last && bucket < peaks_.filled; ++bucket)
+            {
+                lo = qMin(lo, peaks_.minimum.at(bucket));
+                hi = qMax(hi, peaks_.maximum.at(bucket));
+            }
+
+            painter.drawLine(QPointF(x, middle - hi * middle), QPointF(x, middle - lo * middle));
+        }
+    }
+
+    playedPixmap_ = envelope;
+    remainingPixmap_ = envelope;
+
+    QPainter played(&playedPixmap_);
+    played.setCompositionMode(QPainter::CompositionMode_SourceIn);
+    played.fillRect(playedPixmap_.rect(), WAVEFORM_PLAYED_COLOR);
 
-PlayerWidget::PlayerWidget(MediaComponent *media, ApiComponent *api, QWidget *parent) :
+    QPainter remaining(&remainingPixmap_);
+    remaining.setCompositionMode(QPainter::CompositionMode_SourceIn);
+    remaining.fillRect(remainingPixmap_.rect(), WAVEFORM_REMAINING_COLOR);
+
+    countImages(1);
+}
+
+//! The two rendered envelopes are the slider's images
+void WaveformSlider::countImages(int sign)
+{
+    int const count = (playedPixmap_.isNull() ? 0 : 1) + (remainingPixmap_.isNull() ? 0 : 1);
+    qint64 const bytes = ResourceMonitor::pixmapBytes(playedPixmap_) + ResourceMonitor::pixmapBytes(remainingPixmap_);
+    ResourceMonitor::adjust(ResourceMonitor::Images, sign * count, sign * bytes);
+}
+
+void SpectrumWidget::setBars(const QVector<float> &bars)
+{
+    bars_ = bars;
+    update();
+}
+
+void SpectrumWidget::paintEvent(QPaintEvent */*event*/)
+{
+    if (bars_.isEmpty())
+        return;
+
+    QPainter painter(this);
+    int const count = bars_.size();
+    int const h = height();
+
+    for (int i = 0; i < count; ++i)
+    {
+        int const left = i * width() / count;
+        int const right = (i + 1) * width() / count - SPECTRUM_BAR_SPACING;
+        int const barHeight = qRound(bars_.at(i) * h);
+        if (barHeight > 0 && right > left)
+            painter.fillRect(left, h - barHeight, right - left, barHeight, SPECTRUM_BAR_COLOR);
+    }
+}
+
+PlayerWidget::PlayerWidget(MediaComponent *media, ApiComponent *api, LibraryComponent *library, QWidget *parent) :
     QWidget(parent),
     ui(new Ui::PlayerWidget),
-    api_(api), media_(media),
-    model_(new QStandardItemModel(this)), playlist_(new QMediaPlaylist(this)),
-    trayIcon_(new QSystemTrayIcon(this)),stillCurrentPlaylist_(false)
+    api_(api), library_(library), media_(media),
+    model_(new PlaylistModel(this)), sortModel_(new PlaylistSortModel(this)),
+    trayIcon_(new QSystemTrayIcon(this)),stillCurrentPlaylist_(false), background_(false), playlistReleased_(false),
+    prober_(new TrackProber(media->networkManager(), this)), probeTimer_(new QTimer(this)), refreshTimer_(new QTimer(this)),
+    prefetchTimer_(new QTimer(this)),
+    resourcePanel_(0), playbackStatsPanel_(0), radio_(new RadioMode(api, media, this)),
+    spectrum_(new SpectrumAnalyzer(media->player(), this)), spectrumWidget_(0), spectrumEnabled_(false)
 {
     Q_ASSERT(media);
     Q_ASSERT(api);
+    Q_ASSERT(library);
 
     ui->setupUi(this);
 
@@ -34,14 +175,35 @@ PlayerWidget::PlayerWidget(MediaComponent *media, ApiComponent *api, QWidget *pa
     ui->playlistMenuTreeWidget->topLevelItem(SearchResults)->setHidden(true);
     ui->playlistMenuTreeWidget->setCurrentItem(ui->playlistMenuTreeWidget->topLevelItem(MyMusic));
 
-    ui->playlistTableView->setModel(model_);
+    PlaylistItemDelegate *playlistDelegate = new PlaylistItemDelegate(ui->playlistTableView->font(), this);
+    playlistDelegate->setDownloadManager(media_->downloads());
+    connect(media_->downloads(), &DownloadManager::progressUpdated, ui->playlistTableView->viewport(),
+            static_cast<void (QWidget::*)()>(&QWidget::update));
+    ui->playlistTableView->setItemDelegate(playlistDelegate);
+    sortModel_->setSourceModel(model_);
+    ui->playlistTableView->setModel(sortModel_);
+    ui->playlistTableView->setWordWrap(false);
+    ui->playlistTableView->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(ui->playlistTableView, &QTableView::customContextMenuRequested, this, &PlayerWidget::showPlaylistContextMenu);
+    ui->playlistTableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    ui->playlistTableView->verticalHeader()->setDefaultSectionSize(playlistDelegate->rowHeight());
     ui->playlistTableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    for (int column = PlaylistModel::Bitrate; column <= PlaylistModel::Duration; ++column)
+    {
+        ui->playlistTableView->horizontalHeader()->setSectionResizeMode(column, QHeaderView::Fixed);
+        ui->playlistTableView->horizontalHeader()->resizeSection(column, playlistDelegate->columnWidth(column));
+    }
+    ui->playlistTableView->horizontalHeader()->setStretchLastSection(false);
     ui->playlistTableView->horizontalHeader()->setVisible(false);
 
     connect(ui->playlistMenuTreeWidget, SIGNAL(itemSelectionChanged()), this, SLOT(changePlaylistMenuMode()));
+    ui->playlistMenuTreeWidget->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(ui->playlistMenuTreeWidget, &QTreeWidget::customContextMenuRequested, this, &PlayerWidget::showPlaylistMenuContextMenu);
+    connect(library_, &LibraryComponent::libraryChanged, this, &PlayerWidget::refreshLocalMusic);
 
-    connect(media_, &MediaComponent::albumArtExtracted, ui->albumArtLabel, &QLabel::setPixmap);
-    connect(api_, &ApiComponent::playlistReceived, this, &PlayerWidget::setPlaylist);
+    connect(media_, &MediaComponent::albumArtExtracted, this, &PlayerWidget::setAlbumArt);
+    connect(media_->waveform(), &WaveformComponent::peaksUpdated, ui->timeSlider, &WaveformSlider::setPeaks);
+    connect(api_, &ApiComponent::playlistReceived, this, &PlayerWidget::setTracks);
     connect(this, &PlayerWidget::playlistCleared, media_, &MediaComponent::clearPlaylist);
     connect(this, &PlayerWidget::playlistItemAdded, media_, &MediaComponent::addItemToPlaylist);
 
@@ -55,6 +217,13 @@ PlayerWidget::PlayerWidget(MediaComponent *media, ApiComponent *api, QWidget *pa
     connect(ui->forwardButton, &QPushButton::clicked, this, &PlayerWidget::forward);
 
     connect(ui->albumArtLabel, &ClickableLabel::clicked, this, &PlayerWidget::showFullSizeAlbumArt);
+
+    spectrumWidget_ = new SpectrumWidget(ui->albumArtLabel);
+    QVBoxLayout *spectrumLayout = new QVBoxLayout(ui->albumArtLabel);
+    spectrumLayout->setContentsMargins(0, 0, 0, 0);
+    spectrumLayout->addWidget(spectrumWidget_);
+    connect(spectrum_, &SpectrumAnalyzer::barsUpdated, spectrumWidget_, &SpectrumWidget::setBars);
+    spectrumEnabled_ = QSettings().value("spectrum/enabled", false).toBool();
     connect(ui->artistLabel, &ClickableLabel::clicked, this, &PlayerWidget::searchByArtist);
 
     connect(ui->shuffleButton, &QPushButton::clicked, this, &PlayerWidget::solvePlaybackMode);
@@ -64,12 +233,48 @@ PlayerWidget::PlayerWidget(MediaComponent *media, ApiComponent *api, QWidget *pa
     connect(ui->timeSlider, &QSlider::sliderMoved, this, &PlayerWidget::seek);
 
     connect(ui->playlistTableView, &QTableView::doubleClicked, this, &PlayerWidget::playIndex);
+
+    //! Only the queue itself takes drags, see updatePlaylistDragDrop
+    ui->playlistTableView->setDragDropMode(QAbstractItemView::InternalMove);
+    ui->playlistTableView->setDefaultDropAction(Qt::MoveAction);
+    ui->playlistTableView->setDragDropOverwriteMode(false);
+    updatePlaylistDragDrop();
+    QShortcut *removeShortcut = new QShortcut(QKeySequence::Delete, ui->playlistTableView, 0, 0, Qt::WidgetShortcut);
+    connect(removeShortcut, &QShortcut::activated, this, &PlayerWidget::removeSelected);
+
+    QShortcut *resourcePanelShortcut = new QShortcut(QKeySequence("Ctrl+Shift+D"), this);
+    connect(resourcePanelShortcut, &QShortcut::activated, this, &PlayerWidget::showResourcePanel);
+    QShortcut *playbackStatsShortcut = new QShortcut(QKeySequence("Ctrl+Shift+B"), this);
+    connect(playbackStatsShortcut, &QShortcut::activated, this, &PlayerWidget::showPlaybackStats);
+
+    refreshTimer_->setInterval(PLAYLIST_REFRESH_INTERVAL);
+    connect(refreshTimer_, &QTimer::timeout, this, &PlayerWidget::refreshPlaylist);
+    refreshTimer_->start();
+
+    probeTimer_->setSingleShot(true);
+    probeTimer_->setInterval(PROBE_SETTLE_DELAY);
+    connect(probeTimer_, &QTimer::timeout, this, &PlayerWidget::probeVisibleRows);
+    connect(prober_, &TrackProber::probed, this, &PlayerWidget::applyProbeResult);
+    connect(ui->playlistTableView->verticalScrollBar(), &QScrollBar::valueChanged, this, &PlayerWidget::scheduleProbe);
+    connect(model_, &PlaylistModel::rowsInserted, this, &PlayerWidget::scheduleProbe);
+    connect(model_, &PlaylistModel::modelReset, this, &PlayerWidget::scheduleProbe);
+    connect(media_->model(), &PlaylistModel::modelReset, this, &PlayerWidget::scheduleProbe);
+
+    //! A row that stays selected or hovered is likely to be played next
+    prefetchTimer_->setSingleShot(true);
+    prefetchTimer_->setInterval(PREFETCH_SETTLE_DELAY);
+    connect(prefetchTimer_, &QTimer::timeout, this, &PlayerWidget::prefetchSettled);
+    ui->playlistTableView->setMouseTracking(true);
+    connect(ui->playlistTableView, &QTableView::entered, this, &PlayerWidget::schedulePrefetch);
+    connect(ui->playlistTableView->selectionModel(), &QItemSelectionModel::currentRowChanged,
+            this, &PlayerWidget::schedulePrefetch);
     connect(this, &PlayerWidget::startedPlaying, media_, &MediaComponent::playIndex);
     connect(media_->playlist(), &QMediaPlaylist::currentIndexChanged, this, &PlayerWidget::currentPlayItemChanged);
+    connect(media_, &MediaComponent::skipPending, this, &PlayerWidget::showPlayItem);
     connect(media_->player(), &QMediaPlayer::durationChanged, this, &PlayerWidget::durationChanged);
     connect(media_->player(), &QMediaPlayer::positionChanged, this, &PlayerWidget::positionChanged);
     connect(media_->player(), &QMediaPlayer::volumeChanged, this, &PlayerWidget::volumeChanged);
-    connect(media_->player(), &QMediaPlayer::stateChanged, this, &PlayerWidget::stateChanged);
+    connect(media_, &MediaComponent::stateChanged, this, &PlayerWidget::stateChanged);
 }
 
 PlayerWidget::~PlayerWidget()
@@ -77,20 +282,43 @@ PlayerWidget::~PlayerWidget()
     delete ui;
 }
 
-void PlayerWidget::setPlaylist(const ApiComponent::Playlist& playlist)
+void PlayerWidget::setTracks(const PlaylistModel::Tracks &tracks)
 {
+    //! The media playlist no longer mirrors model_ once a listing is shown
+    //! in it, even when the listing turns out unchanged
     stillCurrentPlaylist_ = false;
 
-    clearPlaylist();
+    //! Refreshing the shown list keeps selection, scroll position and
+    //! probe results of the rows that are still there
+    if (!model_->reconcile(tracks))
+        return;
 
-    foreach (const ApiComponent::PlaylistItem& item, playlist)
-        addItem(item);
+    scheduleProbe();
+}
+
+void PlayerWidget::resizeEvent(QResizeEvent *event)
+{
+    scheduleProbe();
+    QWidget::resizeEvent(event);
+}
+
+void PlayerWidget::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    updateSpectrum();
+}
+
+void PlayerWidget::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    updateSpectrum();
 }
 
 void PlayerWidget::closeEvent(QCloseEvent *event)
 {
     hide();
     trayIcon_->show();
+    enterBackground();
     event->ignore();
 }
 
@@ -102,54 +330,94 @@ void PlayerWidget::showFromTray(QSystemTrayIcon::ActivationReason reason)
 
 void PlayerWidget::show()
 {
+    leaveBackground();
     trayIcon_->hide();
     QWidget::show();
 }
 
-void PlayerWidget::clearPlaylist()
+void PlayerWidget::showPlaylistModel(PlaylistModel *model)
 {
-    model_->removeRows(0, model_->rowCount());
-    playlist_->clear();
+    sortModel_->setSourceModel(model);
+    updatePlaylistDragDrop();
+    scheduleProbe();
 }
 
-void PlayerWidget::addItem(const ApiComponent::PlaylistItem &item)
+void PlayerWidget::updatePlaylistDragDrop()
 {
-    int const rowCount = model_->rowCount();
-    model_->insertRow(rowCount);
+    //! Dragging a sorted view around would not say where the rows belong
+    bool const movable = sortModel_->playlistModel() == media_->model() && sortModel_->sortColumn() < 0;
+    ui->playlistTableView->setDragEnabled(movable);
+    ui->playlistTableView->setAcceptDrops(movable);
+    ui->playlistTableView->setDropIndicatorShown(movable);
+}
+
+QVector<int> PlayerWidget::selectedRows() const
+{
+    //! Source rows in the order they are shown
+    QModelIndexList selected = ui->playlistTableView->selectionModel()->selectedRows();
+    std::sort(selected.begin(), selected.end());
+
+    QVector<int> rows;
+    rows.reserve(selected.size());
+    foreach (const QModelIndex& index, selected)
+        rows.append(sortModel_->mapToSource(index).row());
+
+    return rows;
+}
 
-    QFont artistFont(ui->playlistTableView->font());
-    artistFont.setBold(true);
-    QTextDocument textDocument;
-    textDocument.setHtml(item[ApiComponent::Artist]);
-    QStandardItem *artistItem = new QStandardItem(textDocument.toPlainText());
-    artistItem->setFont(artistFont);
-    model_->setItem(rowCount, Artist, artistItem);
-    textDocument.setHtml(item[ApiComponent::Title]);
-    model_->setItem(rowCount, Title, new QStandardItem(textDocument.toPlainText()));
-    QStandardItem* durationItem = new QStandardItem(convertSecondsToTimeString(item[ApiComponent::Duration].toInt()));
-    durationItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-    model_->setItem(rowCount, Duration, durationItem);
+void PlayerWidget::runCommand(const QString &command, const QString &argument)
+{
+    bool const playing = media_->state() == QMediaPlayer::PlayingState;
+
+    if (command == "play-pause" || (command == "play" && !playing) || (command == "pause" && playing))
+        solvePlayPauseAction();
+    else if (command == "next")
+        forward();
+    else if (command == "previous")
+        rewind();
+    else if (command == "show" || command == "search")
+    {
+        show();
+        raise();
+        activateWindow();
 
-    playlist_->addMedia(QUrl(item[ApiComponent::Url]));
+        if (command == "search")
+            search(argument, false);
+    }
+}
+
+int PlayerWidget::playlistIndex(const QModelIndex &index) const
+{
+    //! The current playlist view maps onto the queue through the sort order;
+    //! any other list was handed to the queue in its shown order
+    if (sortModel_->playlistModel() == media_->model())
+        return sortModel_->mapToSource(index).row();
+
+    return index.row();
 }
 
 QString PlayerWidget::convertSecondsToTimeString(int seconds)
 {
-    QString const format = seconds >= 3600 ? "hh:mm:ss" :"mm:ss";
-    return QDateTime::fromTime_t(seconds).toUTC().toString(format);
+    return PlaylistModel::formatDuration(seconds);
 }
 
 void PlayerWidget::playIndex(const QModelIndex &index)
 {
     if (!stillCurrentPlaylist_)
     {
-        media_->copyModel(model_);
-        media_->copyPlaylist(playlist_);
+        //! Playback follows the order the list is shown in
+        media_->setTracks(sortModel_->sortedTracks());
         stillCurrentPlaylist_ = true;
     }
 
-    int const currentIndex = index.row();
-    emit startedPlaying(currentIndex);
+    emit startedPlaying(playlistIndex(index));
+}
+
+void PlayerWidget::playRow(int row)
+{
+    PlaylistModel * const model = sortModel_->playlistModel();
+    if (row >= 0 && row < model->rowCount())
+        playIndex(sortModel_->mapFromSource(model->index(row, 0)));
 }
 
 void PlayerWidget::showCurrentPlayItemText(const QString& artist, const QString& title)
@@ -160,17 +428,36 @@ void PlayerWidget::showCurrentPlayItemText(const QString& artist, const QString&
     QString const playItemText = artist + dash + title;
     setWindowTitle(playItemText + dash + "Flow");
     trayIcon_->setToolTip(playItemText);
-    trayIcon_->showMessage("Now playing", playItemText, QSystemTrayIcon::Information, SYSTEM_TRAY_MESSAGE_TIMEOUT_HINT);
 }
 
 void PlayerWidget::currentPlayItemChanged(int position)
 {
-    QStandardItemModel * const model = media_->model();
+    if (media_->isEditingQueue() || position < 0 || position >= media_->model()->rowCount())
+        return;
+
+    showPlayItem(position);
+
+    //! Notify once per settled track, not for every skip on the way there
+    trayIcon_->showMessage("Now playing", trayIcon_->toolTip(), QSystemTrayIcon::Information, SYSTEM_TRAY_MESSAGE_TIMEOUT_HINT);
+}
+
+void PlayerWidget::showPlayItem(int position)
+{
+    PlaylistModel * const model = media_->model();
+
+    if (position < 0 || position >= model->rowCount())
+        return;
 
     if (stillCurrentPlaylist_)
-        ui->playlistTableView->selectRow(position);
+    {
+        if (sortModel_->playlistModel() == model)
+            ui->playlistTableView->selectRow(sortModel_->mapFromSource(model->index(position, 0)).row());
+        else
+            ui->playlistTableView->selectRow(position);
+    }
 
-    showCurrentPlayItemText(model->item(position, Artist)->text(), model->item(position, Title)->text());
+    PlaylistModel::Track const& track = model->track(position);
+    showCurrentPlayItemText(track.artist, track.title);
 }
 
 void PlayerWidget::playbackModeChanged(QAction *action)
@@ -178,7 +465,7 @@ void PlayerWidget::playbackModeChanged(QAction *action)
     QString const playbackMode = action->text();
 
     if (playbackMode == "Shuffle")
-        media_->setPlaybackMode(QMediaPlaylist::Random);
+        media_->setShuffled(true);
     if (playbackMode == "Repeat Single")
         media_->setPlaybackMode(QMediaPlaylist::CurrentItemInLoop);
     else if (playbackMode == "Repeat All")
@@ -194,6 +481,9 @@ void PlayerWidget::durationChanged(qint64 duration)
 
 void PlayerWidget::positionChanged(qint64 progress)
 {
+    if (background_)
+        return;
+
     if (!ui->timeSlider->isSliderDown())
         ui->timeSlider->setValue(progress / 1000);
 
@@ -280,21 +570,32 @@ void PlayerWidget::solvePlaybackMode()
     bool const shuffle = ui->shuffleButton->isChecked();
     bool const loop = ui->loopButton->isChecked();
 
-    if (shuffle && loop)
-        media_->setPlaybackMode(QMediaPlaylist::CurrentItemInLoop);
-    else if (shuffle && !loop)
-        media_->setPlaybackMode(QMediaPlaylist::Random);
-    else if (!shuffle && loop)
+    media_->setShuffled(shuffle);
+
+    if (loop)
         media_->setPlaybackMode(QMediaPlaylist::CurrentItemInLoop);
     else media_->setPlaybackMode(QMediaPlaylist::Loop);
 }
 
+void PlayerWidget::setAlbumArt(const QPixmap &pixmap)
+{
+    const QPixmap *current = ui->albumArtLabel->pixmap();
+    qint64 const currentBytes = current ? ResourceMonitor::pixmapBytes(*current) : 0;
+    qint64 const currentCount = current && !current->isNull() ? 1 : 0;
+
+    ResourceMonitor::adjust(ResourceMonitor::Images, (pixmap.isNull() ? 0 : 1) - currentCount,
+                            ResourceMonitor::pixmapBytes(pixmap) - currentBytes);
+    ui->albumArtLabel->setPixmap(pixmap);
+}
+
 void PlayerWidget::showFullSizeAlbumArt()
 {
     QPixmap const * albumArt = ui->albumArtLabel->pixmap();
-    if (!albumArt->size().isNull())
+    if (albumArt && !albumArt->isNull())
     {
         QLabel *albumArtLabel = new QLabel();
+        albumArtLabel->setAttribute(Qt::WA_DeleteOnClose);
+        ResourceMonitor::track(albumArtLabel, ResourceMonitor::Images, ResourceMonitor::pixmapBytes(*albumArt));
         albumArtLabel->setWindowTitle(ui->artistLabel->text() + ui->dashLabel->text() + ui->titleLabel->text());
         albumArtLabel->setWindowFlags(Qt::Dialog);
         albumArtLabel->setWindowIcon(QIcon(":icons/logo.png"));
@@ -307,6 +608,82 @@ void PlayerWidget::showFullSizeAlbumArt()
     }
 }
 
+void PlayerWidget::showResourcePanel()
+{
+    if (!resourcePanel_)
+        resourcePanel_ = new ResourcePanel(api_->scheduler(), this);
+
+    resourcePanel_->show();
+    resourcePanel_->raise();
+}
+
+void PlayerWidget::showPlaybackStats()
+{
+    if (!playbackStatsPanel_)
+        playbackStatsPanel_ = new PlaybackStatsPanel(media_->bufferMonitor(), this);
+
+    playbackStatsPanel_->show();
+    playbackStatsPanel_->raise();
+}
+
+void PlayerWidget::setSpectrumEnabled(bool enabled)
+{
+    spectrumEnabled_ = enabled;
+    QSettings().setValue("spectrum/enabled", enabled);
+    updateSpectrum();
+}
+
+void PlayerWidget::updateSpectrum()
+{
+    //! Hidden to the tray nothing is probed or transformed at all
+    bool const active = spectrumEnabled_ && isVisible() && !isMinimized();
+    spectrum_->setActive(active);
+    spectrumWidget_->setVisible(spectrumEnabled_);
+}
+
+void PlayerWidget::enterBackground()
+{
+    if (background_)
+        return;
+
+    background_ = true;
+    media_->setBackground(true);
+    setAlbumArt(QPixmap());
+
+    refreshTimer_->stop();
+    probeTimer_->stop();
+    prober_->cancelAll();
+    prefetchTimer_->stop();
+
+    //! A browsed list that is not the queue is fetched again on show
+    QTreeWidgetItem * const item = ui->playlistMenuTreeWidget->currentItem();
+    bool const refetchable = item && (item->parent() || item == ui->playlistMenuTreeWidget->topLevelItem(MyMusic) ||
+                                      item == ui->playlistMenuTreeWidget->topLevelItem(SuggestedMusic) ||
+                                      item == ui->playlistMenuTreeWidget->topLevelItem(LocalMusic));
+    if (refetchable && model_->rowCount() > 0 && !stillCurrentPlaylist_ && sortModel_->playlistModel() == model_)
+    {
+        model_->clear();
+        playlistReleased_ = true;
+    }
+}
+
+void PlayerWidget::leaveBackground()
+{
+    if (!background_)
+        return;
+
+    background_ = false;
+    media_->setBackground(false);
+    positionChanged(media_->player()->position());
+    refreshTimer_->start();
+
+    if (playlistReleased_)
+    {
+        playlistReleased_ = false;
+        changePlaylistMenuMode();
+    }
+}
+
 void PlayerWidget::search(const QString &text, bool artist)
 {
     ApiComponent::SearchQuery query;
@@ -316,7 +693,7 @@ void PlayerWidget::search(const QString &text, bool artist)
     api_->requestPlaylistBySearchQuery(query);
     ui->searchEdit->setText(query.text);
     ui->searchComboBox->setCurrentIndex(artist);
-    ui->playlistTableView->setModel(model_);
+    showPlaylistModel(model_);
 
     QTreeWidgetItem * const searchMenuItem = ui->playlistMenuTreeWidget->topLevelItem(SearchResults);
     searchMenuItem->setHidden(false);
@@ -354,7 +731,7 @@ void PlayerWidget::changePlaylistMenuMode()
     QModelIndex const parentIndex = selectedIndex.parent();
 
     if (!parentIndex.isValid() && parentIndex.row() != CurrentPlaylist)
-        ui->playlistTableView->setModel(model_);
+        showPlaylistModel(model_);
 
     if (parentIndex.isValid())
         api_->requestPopularPlaylistByGenre(ui->playlistMenuTreeWidget->currentItem()->text(0));
@@ -370,8 +747,13 @@ void PlayerWidget::changePlaylistMenuMode()
         switch (row) {
         case CurrentPlaylist:
             stillCurrentPlaylist_ = true;
-            ui->playlistTableView->setModel(media_->model());
-            ui->playlistTableView->selectRow(media_->playlist()->currentIndex());
+            showPlaylistModel(media_->model());
+            if (media_->playlist()->currentIndex() >= 0)
+            {
+                QModelIndex const current = media_->model()->index(media_->playlist()->currentIndex(), 0);
+                ui->playlistTableView->selectRow(sortModel_->mapFromSource(current).row());
+            }
+            scheduleProbe();
             break;
         case MyMusic:
             api_->requestAuthUserPlaylist();
@@ -379,12 +761,323 @@ void PlayerWidget::changePlaylistMenuMode()
         case SuggestedMusic:
             api_->requestSuggestedPlaylist();
             break;
+        case LocalMusic:
+            showLocalMusic();
+            break;
         default:
             break;
         }
     }
 }
 
+void PlayerWidget::refreshPlaylist()
+{
+    //! Cheap when nothing changed: the reply is diffed against the shown rows
+    QTreeWidgetItem * const item = ui->playlistMenuTreeWidget->currentItem();
+    if (isVisible() && item == ui->playlistMenuTreeWidget->topLevelItem(MyMusic))
+        api_->requestAuthUserPlaylist();
+}
+
+void PlayerWidget::showLocalMusic()
+{
+    if (library_->directories().isEmpty())
+        addLibraryDirectory();
+    else
+        setTracks(library_->tracks());
+}
+
+void PlayerWidget::refreshLocalMusic()
+{
+    if (ui->playlistMenuTreeWidget->currentItem() == ui->playlistMenuTreeWidget->topLevelItem(LocalMusic))
+        setTracks(library_->tracks());
+}
+
+void PlayerWidget::addLibraryDirectory()
+{
+    QString const directory = QFileDialog::getExistingDirectory(this, "Add Music Folder", QDir::homePath());
+    if (!directory.isEmpty())
+        library_->addDirectory(directory);
+}
+
+void PlayerWidget::showPlaylistMenuContextMenu(const QPoint &position)
+{
+    QTreeWidgetItem * const item = ui->playlistMenuTreeWidget->itemAt(position);
+    if (item != ui->playlistMenuTreeWidget->topLevelItem(LocalMusic))
+        return;
+
+    QMenu menu(this);
+    QAction * const addAction = menu.addAction("Add folder...");
+    QAction * const rescanAction = menu.addAction("Rescan");
+    rescanAction->setEnabled(!library_->directories().isEmpty() && !library_->isScanning());
+
+    QAction * const chosenAction = menu.exec(ui->playlistMenuTreeWidget->viewport()->mapToGlobal(position));
+    if (chosenAction == addAction)
+        addLibraryDirectory();
+    else if (chosenAction == rescanAction)
+        library_->rescan();
+}
+
+void PlayerWidget::showPlaylistContextMenu(const QPoint &position)
+{
+    QMenu menu(this);
+    bool const queueShown = sortModel_->playlistModel() == media_->model();
+    bool const anySelected = ui->playlistTableView->selectionModel()->hasSelection();
+
+    QAction * const playNextAction = menu.addAction("Play next");
+    playNextAction->setEnabled(anySelected);
+    QAction * const enqueueAction = menu.addAction("Add to queue");
+    enqueueAction->setVisible(!queueShown);
+    enqueueAction->setEnabled(anySelected);
+    QAction * const removeAction = menu.addAction("Remove from queue");
+    removeAction->setVisible(queueShown);
+    removeAction->setEnabled(anySelected);
+
+    int variantCount = 0;
+    if (!queueShown && sortModel_->playlistModel())
+    {
+        foreach (int row, selectedRows())
+            variantCount += sortModel_->playlistModel()->track(row).variants.size();
+    }
+    QAction * const variantsAction = menu.addAction(QString("Show %1 other uploads").arg(variantCount));
+    variantsAction->setVisible(variantCount > 0);
+
+    menu.addSeparator();
+    QMenu * const sortMenu = menu.addMenu("Sort by");
+    QActionGroup * const sortGroup = new QActionGroup(sortMenu);
+
+    QList<QPair<QString, int> > columns;
+    columns.append(qMakePair(QString("Original order"), -1));
+    columns.append(qMakePair(QString("Artist"), int(PlaylistModel::Artist)));
+    columns.append(qMakePair(QString("Title"), int(PlaylistModel::Title)));
+    columns.append(qMakePair(QString("Duration"), int(PlaylistModel::Duration)));
+
+    for (int i = 0; i < columns.size(); ++i)
+    {
+        QAction * const action = sortMenu->addAction(columns.at(i).first);
+        action->setData(columns.at(i).second);
+        action->setCheckable(true);
+        action->setChecked(sortModel_->sortColumn() == columns.at(i).second);
+        sortGroup->addAction(action);
+    }
+
+    sortMenu->addSeparator();
+    QAction * const descendingAction = sortMenu->addAction("Descending");
+    descendingAction->setCheckable(true);
+    descendingAction->setChecked(sortModel_->sortOrder() == Qt::DescendingOrder);
+    descendingAction->setEnabled(sortModel_->sortColumn() >= 0);
+
+    menu.addSeparator();
+    QAction * const offlineAction = menu.addAction("Make available offline");
+    offlineAction->setEnabled(sortModel_->playlistModel() && sortModel_->rowCount() > 0);
+    QAction * const cancelOfflineAction = menu.addAction("Cancel offline downloads");
+    cancelOfflineAction->setEnabled(media_->downloads()->pendingCount() > 0);
+
+    menu.addSeparator();
+    QAction * const radioAction = menu.addAction("Radio");
+    radioAction->setCheckable(true);
+    radioAction->setChecked(radio_->isEnabled());
+    radioAction->setToolTip("Keep playing similar tracks after the queue ends");
+
+    menu.addSeparator();
+    QAction * const spectrumAction = menu.addAction("Spectrum");
+    spectrumAction->setCheckable(true);
+    spectrumAction->setChecked(spectrumEnabled_);
+
+    QAction * const chosenAction = menu.exec(ui->playlistTableView->viewport()->mapToGlobal(position));
+    if (!chosenAction)
+        return;
+
+    if (chosenAction == playNextAction)
+    {
+        playSelectedNext();
+        return;
+    }
+
+    if (chosenAction == enqueueAction)
+    {
+        enqueueSelected();
+        return;
+    }
+
+    if (chosenAction == removeAction)
+    {
+        removeSelected();
+        return;
+    }
+
+    if (chosenAction == variantsAction)
+    {
+        expandSelectedVariants();
+        return;
+    }
+
+    if (chosenAction == offlineAction)
+    {
+        media_->downloads()->pin(sortModel_->sortedTracks());
+        return;
+    }
+
+    if (chosenAction == cancelOfflineAction)
+    {
+        media_->downloads()->cancelAll();
+        return;
+    }
+
+    if (chosenAction == radioAction)
+    {
+        radio_->setEnabled(radioAction->isChecked());
+        return;
+    }
+
+    if (chosenAction == spectrumAction)
+    {
+        setSpectrumEnabled(spectrumAction->isChecked());
+        return;
+    }
+
+    int column = sortModel_->sortColumn();
+    Qt::SortOrder order = sortModel_->sortOrder();
+    if (chosenAction == descendingAction)
+        order = descendingAction->isChecked() ? Qt::DescendingOrder : Qt::AscendingOrder;
+    else
+        column = chosenAction->data().toInt();
+
+    //! The playing queue keeps its order; playing from the re-sorted list replaces it
+    if (sortModel_->playlistModel() == model_)
+        stillCurrentPlaylist_ = false;
+
+    sortModel_->sort(column, order);
+    updatePlaylistDragDrop();
+    scheduleProbe();
+}
+
+void PlayerWidget::scheduleProbe()
+{
+    probeTimer_->start();
+}
+
+void PlayerWidget::probeVisibleRows()
+{
+    QTableView * const view = ui->playlistTableView;
+    PlaylistModel * const model = sortModel_->playlistModel();
+    QList<TrackProber::Request> requests;
+
+    if (model && isVisible())
+    {
+        int first = view->rowAt(0);
+        int last = view->rowAt(view->viewport()->height() - 1);
+        if (first < 0)
+            first = 0;
+        if (last < 0)
+            last = sortModel_->rowCount() - 1;
+
+        for (int proxyRow = first; proxyRow <= last; ++proxyRow)
+        {
+            int const row = sortModel_->mapToSource(sortModel_->index(proxyRow, 0)).row();
+            PlaylistModel::Track const& track = model->track(row);
+            if (!track.isProbed())
+            {
+                TrackProber::Request request;
+                request.row = row;
+                request.url = track.url;
+                request.duration = track.duration;
+                requests.append(request);
+            }
+        }
+    }
+
+    prober_->probe(requests);
+}
+
+void PlayerWidget::applyProbeResult(int row, const QUrl &url, int bitrate, qint64 size)
+{
+    foreach (PlaylistModel *model, QList<PlaylistModel*>() << model_ << media_->model())
+    {
+        if (row < model->rowCount() && model->track(row).url == url)
+            model->setTrackInfo(row, bitrate, size);
+    }
+}
+
+void PlayerWidget::schedulePrefetch(const QModelIndex &index)
+{
+    PlaylistModel * const model = sortModel_->playlistModel();
+    if (!model || !index.isValid())
+        return;
+
+    QUrl const url = model->track(sortModel_->mapToSource(index).row()).url;
+    if (url == prefetchUrl_)
+        return;
+
+    //! Moving on drops whatever the previous row was fetching
+    prefetchUrl_ = url;
+    media_->prefetch(QUrl());
+    prefetchTimer_->start();
+}
+
+void PlayerWidget::prefetchSettled()
+{
+    media_->prefetch(prefetchUrl_);
+}
+
+void PlayerWidget::playSelectedNext()
+{
+    QVector<int> const rows = selectedRows();
+    PlaylistModel * const model = sortModel_->playlistModel();
+    if (!model || rows.isEmpty())
+        return;
+
+    if (model == media_->model())
+    {
+        media_->playNext(rows);
+        return;
+    }
+
+    PlaylistModel::Tracks tracks;
+    foreach (int row, rows)
+        tracks.append(model->track(row));
+
+    //! The shown list and the queue no longer line up row for row
+    media_->playNext(tracks);
+    stillCurrentPlaylist_ = false;
+}
+
+void PlayerWidget::enqueueSelected()
+{
+    QVector<int> const rows = selectedRows();
+    PlaylistModel * const model = sortModel_->playlistModel();
+    if (!model || model == media_->model() || rows.isEmpty())
+        return;
+
+    PlaylistModel::Tracks tracks;
+    foreach (int row, rows)
+        tracks.append(model->track(row));
+
+    media_->appendTracks(tracks);
+    stillCurrentPlaylist_ = false;
+}
+
+void PlayerWidget::removeSelected()
+{
+    if (sortModel_->playlistModel() == media_->model())
+        media_->removeTracks(selectedRows());
+}
+
+void PlayerWidget::expandSelectedVariants()
+{
+    //! The queue mirrors the media playlist row for row, so it is never expanded
+    PlaylistModel * const model = sortModel_->playlistModel();
+    if (!model || model == media_->model())
+        return;
+
+    //! From the bottom up, so the rows still to expand keep their indexes
+    QVector<int> rows = selectedRows();
+    std::sort(rows.begin(), rows.end());
+    for (int i = rows.size() - 1; i >= 0; --i)
+        model->expandVariants(rows.at(i));
+
+    stillCurrentPlaylist_ = false;
+}
+
 void PlayerWidget::on_clearSearchTextButton_clicked()
 {
     ui->searchEdit->clear();
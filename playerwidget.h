@@ -2,11 +2,16 @@
 #define PLAYER_H
 
 #include "apicomponent.h"
+#include "librarycomponent.h"
 #include "mediacomponent.h"
+#include "playlistmodel.h"
+#include "playlistsortmodel.h"
+#include "trackprober.h"
+#include "waveformcomponent.h"
 
 #include <QLabel>
 #include <QMouseEvent>
-#include <QStandardItemModel>
+#include <QPixmap>
 #include <QSlider>
 #include <QStyle>
 #include <QSystemTrayIcon>
@@ -16,6 +21,11 @@ namespace Ui {
 class PlayerWidget;
 }
 
+class PlaybackStatsPanel;
+class RadioMode;
+class ResourcePanel;
+class SpectrumAnalyzer;
+class QTimer;
 class QTreeWidgetItem;
 
 class ClickableLabel : public QLabel
@@ -60,6 +70,54 @@ protected:
     }
 };
 
+class WaveformSlider : public MouseDirectJumpSlider
+{
+    Q_OBJECT
+
+public:
+    explicit WaveformSlider(QWidget *parent = 0) : MouseDirectJumpSlider(parent) {}
+
+    ~WaveformSlider() { countImages(-1); }
+
+public slots:
+    void setPeaks(const WaveformComponent::Peaks& peaks);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
+
+private:
+    void renderWaveform();
+    void countImages(int sign);
+
+    WaveformComponent::Peaks peaks_;
+    QPixmap playedPixmap_;
+    QPixmap remainingPixmap_;
+};
+
+//! Bars drawn over the album art; mouse events pass through to the label
+class SpectrumWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit SpectrumWidget(QWidget *parent = 0) : QWidget(parent)
+    {
+        setAttribute(Qt::WA_TransparentForMouseEvents);
+    }
+
+    ~SpectrumWidget() {}
+
+public slots:
+    void setBars(const QVector<float>& bars);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+
+private:
+    QVector<float> bars_;
+};
+
 class PlayerWidget : public QWidget
 {
     Q_OBJECT
@@ -70,17 +128,11 @@ class PlayerWidget : public QWidget
         MyMusic,
         SuggestedMusic,
         PopularMusic,
+        LocalMusic,
         SearchResults,
         Count
     };
 
-    enum PlaylistColumn
-    {
-        Artist,
-        Title,
-        Duration
-    };
-
     enum SystemTrayControl
     {
         Show = 0,
@@ -97,16 +149,24 @@ class PlayerWidget : public QWidget
     };
 
 public:
-    explicit PlayerWidget(MediaComponent *media, ApiComponent *api, QWidget *parent = 0);
+    explicit PlayerWidget(MediaComponent *media, ApiComponent *api, LibraryComponent *library, QWidget *parent = 0);
     ~PlayerWidget();
 
 public slots:
     void show();
 
-    void setPlaylist(const ApiComponent::Playlist& playlist);
+    void setTracks(const PlaylistModel::Tracks& tracks);
+
+    void playRow(int row);
+
+    //! Commands forwarded from another launch, see InstanceGuard
+    void runCommand(const QString& command, const QString& argument);
 
 protected:
     virtual void closeEvent(QCloseEvent *);
+    virtual void resizeEvent(QResizeEvent *);
+    virtual void showEvent(QShowEvent *);
+    virtual void hideEvent(QHideEvent *);
 
 private slots:
     void showFromTray(QSystemTrayIcon::ActivationReason);
@@ -121,6 +181,8 @@ private slots:
 
     void currentPlayItemChanged(int position);
 
+    void showPlayItem(int position);
+
     void playbackModeChanged(QAction *action);
 
 
@@ -143,8 +205,17 @@ private slots:
     void forward();
 
 
+    void setAlbumArt(const QPixmap& pixmap);
+
     void showFullSizeAlbumArt();
 
+    void showResourcePanel();
+
+    void showPlaybackStats();
+
+
+    void setSpectrumEnabled(bool enabled);
+
     void search(const QString& text, bool artist);
 
     void searchByArtist(const QString& artist = QString());
@@ -155,6 +226,36 @@ private slots:
 
     void changePlaylistMenuMode();
 
+    void refreshPlaylist();
+
+    void showLocalMusic();
+
+    void refreshLocalMusic();
+
+    void addLibraryDirectory();
+
+    void showPlaylistMenuContextMenu(const QPoint& position);
+
+    void showPlaylistContextMenu(const QPoint& position);
+
+    void scheduleProbe();
+
+    void probeVisibleRows();
+
+    void applyProbeResult(int row, const QUrl& url, int bitrate, qint64 size);
+
+    void schedulePrefetch(const QModelIndex& index);
+
+    void prefetchSettled();
+
+    void playSelectedNext();
+
+    void enqueueSelected();
+
+    void removeSelected();
+
+    void expandSelectedVariants();
+
 
     void on_clearSearchTextButton_clicked();
 
@@ -171,22 +272,46 @@ private:
 
     void initSystemTrayMenu();
 
+    void updateSpectrum();
+
+    void enterBackground();
+
+    void leaveBackground();
+
     void showCurrentPlayItemText(const QString& artist, const QString& title);
 
-    void clearPlaylist();
+    void showPlaylistModel(PlaylistModel *model);
+
+    void updatePlaylistDragDrop();
+
+    QVector<int> selectedRows() const;
 
-    void addItem(const ApiComponent::PlaylistItem& item);
+    int playlistIndex(const QModelIndex& index) const;
 
 
     QString convertSecondsToTimeString(int seconds);
 
     Ui::PlayerWidget *ui;
     ApiComponent *api_;
+    LibraryComponent *library_;
     MediaComponent *media_;
-    QStandardItemModel *model_;
-    QMediaPlaylist *playlist_;
+    PlaylistModel *model_;
+    PlaylistSortModel *sortModel_;
     QSystemTrayIcon *trayIcon_;
     bool stillCurrentPlaylist_;
+    bool background_;
+    bool playlistReleased_;
+    TrackProber *prober_;
+    QTimer *probeTimer_;
+    QTimer *refreshTimer_;
+    QTimer *prefetchTimer_;
+    QUrl prefetchUrl_;
+    ResourcePanel *resourcePanel_;
+    PlaybackStatsPanel *playbackStatsPanel_;
+    RadioMode *radio_;
+    SpectrumAnalyzer *spectrum_;
+    SpectrumWidget *spectrumWidget_;
+    bool spectrumEnabled_;
 };
 
 #endif // PLAYER_H
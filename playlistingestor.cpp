@@ -0,0 +1,265 @@
+#include "playlistingestor.h"
+
+#include <QDateTime>
+#include <QHash>
+#include <QPair>
+#include <QXmlStreamReader>
+#include <QtConcurrent>
+
+static const int DUPLICATE_DURATION_TOLERANCE = 3;
+
+namespace
+{
+
+const QHash<QString, QChar>& namedEntities()
+{
+    static QHash<QString, QChar> const entities = []()
+    {
+        QHash<QString, QChar> entities;
+        entities.insert("amp", '&');
+        entities.insert("lt", '<');
+        entities.insert("gt", '>');
+        entities.insert("quot", '"');
+        entities.insert("apos", '\'');
+        entities.insert("nbsp", QChar(0x00a0));
+        entities.insert("ndash", QChar(0x2013));
+        entities.insert("mdash", QChar(0x2014));
+        entities.insert("laquo", QChar(0x00ab));
+        entities.insert("raquo", QChar(0x00bb));
+        return entities;
+    }();
+
+    return entities;
+}
+
+//! Streams <audio> elements; rows missing any of the required fields are skipped
+PlaylistModel::Tracks parse(const QByteArray& reply)
+{
+    PlaylistModel::Tracks tracks;
+    QXmlStreamReader reader(reply);
+    //! The urls were signed when the reply was made, which is close enough
+    qint64 const signedAt = QDateTime::currentMSecsSinceEpoch();
+
+    if (!reader.readNextStartElement() || reader.name() != "response")
+        return tracks;
+
+    while (reader.readNextStartElement())
+    {
+        if (reader.name() != "audio")
+        {
+            reader.skipCurrentElement();
+            continue;
+        }
+
+        PlaylistModel::Track track;
+        QString audioId, ownerId, duration, url;
+
+        while (reader.readNextStartElement())
+        {
+            if (reader.name() == "aid")
+                audioId = reader.readElementText();
+            else if (reader.name() == "owner_id")
+                ownerId = reader.readElementText();
+            else if (reader.name() == "artist")
+                track.artist = reader.readElementText();
+            else if (reader.name() == "title")
+                track.title = reader.readElementText();
+            else if (reader.name() == "duration")
+                duration = reader.readElementText();
+            else if (reader.name() == "url")
+                url = reader.readElementText();
+            else
+                reader.skipCurrentElement();
+        }
+
+        if (!track.artist.isEmpty() && !track.title.isEmpty() && !duration.isEmpty() && !url.isEmpty())
+        {
+            if (!audioId.isEmpty() && !ownerId.isEmpty())
+                track.id = ownerId + '_' + audioId;
+            track.duration = duration.toInt();
+            track.url = QUrl(url);
+            track.signedAt = signedAt;
+            tracks.append(track);
+        }
+    }
+
+    return tracks;
+}
+
+void normalize(PlaylistModel::Track& track)
+{
+    track.artist = PlaylistIngestor::decodeEntities(track.artist);
+    track.title = PlaylistIngestor::decodeEntities(track.title);
+    track.durationText = PlaylistModel::formatDuration(track.duration);
+}
+
+QString duplicateKey(const PlaylistModel::Track& track)
+{
+    QString key;
+    key.reserve(track.artist.size() + track.title.size() + 1);
+
+    foreach (QChar c, track.artist.toCaseFolded())
+    {
+        if (c.isLetterOrNumber())
+            key += c;
+    }
+
+    //! Without a separator "ab" - "c" and "a" - "bc" would be one song
+    if (!key.isEmpty())
+        key += '\n';
+
+    int const artistSize = key.size();
+    foreach (QChar c, track.title.toCaseFolded())
+    {
+        if (c.isLetterOrNumber())
+            key += c;
+    }
+
+    return key.size() > artistSize ? key : QString();
+}
+
+PlaylistModel::Tracks ingestReply(const QByteArray& reply, bool collapseDuplicates)
+{
+    PlaylistModel::Tracks tracks = parse(reply);
+    QtConcurrent::blockingMap(tracks, normalize);
+
+    if (collapseDuplicates)
+        PlaylistIngestor::collapseDuplicates(tracks);
+
+    return tracks;
+}
+
+}
+
+PlaylistIngestor::PlaylistIngestor(QObject *parent) : QObject(parent)
+{
+    qRegisterMetaType<PlaylistModel::Tracks>();
+
+    //! Replies are parsed one at a time; normalizing runs on the global pool
+    pool_.setMaxThreadCount(1);
+
+    connect(&watcher_, &QFutureWatcher<PlaylistModel::Tracks>::finished, this, &PlaylistIngestor::deliver);
+}
+
+PlaylistIngestor::~PlaylistIngestor()
+{
+    watcher_.waitForFinished();
+}
+
+QString PlaylistIngestor::decodeEntities(const QString &text)
+{
+    int ampersand = text.indexOf('&');
+    if (ampersand < 0)
+        return text.simplified();
+
+    QString decoded;
+    decoded.reserve(text.size());
+    int position = 0;
+
+    while (ampersand >= 0)
+    {
+        decoded += text.midRef(position, ampersand - position);
+        position = ampersand + 1;
+
+        int const semicolon = text.indexOf(';', ampersand);
+        if (semicolon > ampersand + 1)
+        {
+            QStringRef const name = text.midRef(ampersand + 1, semicolon - ampersand - 1);
+            bool ok = false;
+            uint code = 0;
+
+            if (name.startsWith("#x") || name.startsWith("#X"))
+                code = text.midRef(ampersand + 3, name.size() - 2).toUInt(&ok, 16);
+            else if (name.startsWith('#'))
+                code = text.midRef(ampersand + 2, name.size() - 1).toUInt(&ok, 10);
+            else
+            {
+                QHash<QString, QChar>::const_iterator const entity = namedEntities().constFind(name.toString());
+                if (entity != namedEntities().constEnd())
+                {
+                    decoded += *entity;
+                    position = semicolon + 1;
+                }
+            }
+
+            if (ok && code > 0 && code <= 0x10ffff)
+            {
+                uint const ucs4 = code;
+                decoded += QString::fromUcs4(&ucs4, 1);
+                position = semicolon + 1;
+            }
+        }
+
+        if (position == ampersand + 1)
+            decoded += '&';
+
+        ampersand = text.indexOf('&', position);
+    }
+
+    decoded += text.midRef(position);
+    return decoded.simplified();
+}
+
+void PlaylistIngestor::collapseDuplicates(PlaylistModel::Tracks &tracks)
+{
+    //! Buckets are as wide as the tolerance, so a match is in the track's
+    //! own bucket or a neighbouring one: three lookups per track at most
+    typedef QPair<QString, int> GroupKey;
+    QHash<GroupKey, int> groups;
+    groups.reserve(tracks.size());
+
+    PlaylistModel::Tracks collapsed;
+    collapsed.reserve(tracks.size());
+
+    foreach (const PlaylistModel::Track& track, tracks)
+    {
+        QString const key = duplicateKey(track);
+        int const bucket = track.duration / DUPLICATE_DURATION_TOLERANCE;
+        int row = -1;
+
+        for (int neighbour = bucket - 1; neighbour <= bucket + 1 && row < 0 && !key.isEmpty(); ++neighbour)
+        {
+            QHash<GroupKey, int>::const_iterator const group = groups.constFind(qMakePair(key, neighbour));
+            if (group != groups.constEnd() &&
+                    qAbs(collapsed.at(group.value()).duration - track.duration) <= DUPLICATE_DURATION_TOLERANCE)
+                row = group.value();
+        }
+
+        if (row < 0)
+        {
+            if (!key.isEmpty() && !groups.contains(qMakePair(key, bucket)))
+                groups.insert(qMakePair(key, bucket), collapsed.size());
+            collapsed.append(track);
+            continue;
+        }
+
+        PlaylistModel::Track& representative = collapsed[row];
+        if (track.bitrate > representative.bitrate)
+        {
+            PlaylistModel::Track better = track;
+            better.variants.swap(representative.variants);
+            better.variants.append(representative);
+            representative = better;
+        }
+        else
+            representative.variants.append(track);
+    }
+
+    tracks = collapsed;
+}
+
+void PlaylistIngestor::ingest(const QByteArray &reply, bool collapseDuplicates)
+{
+    //! A newer reply replaces the watched future, so a stale one is never delivered
+    watcher_.setFuture(QtConcurrent::run(&pool_, ingestReply, reply, collapseDuplicates));
+}
+
+QFuture<PlaylistModel::Tracks> PlaylistIngestor::read(const QByteArray &reply)
+{
+    return QtConcurrent::run(&pool_, ingestReply, reply, false);
+}
+
+void PlaylistIngestor::deliver()
+{
+    emit tracksReady(watcher_.result());
+}
@@ -0,0 +1,47 @@
+#ifndef PLAYLISTINGESTOR_H
+#define PLAYLISTINGESTOR_H
+
+#include "playlistmodel.h"
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QThreadPool>
+
+//! Turns API replies into finished model rows off the GUI thread: the XML
+//! is streamed instead of built into a DOM, then entities are decoded and
+//! durations formatted in parallel. Only the newest reply is delivered.
+class PlaylistIngestor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PlaylistIngestor(QObject *parent = 0);
+    ~PlaylistIngestor();
+
+    //! Plain text of an HTML-escaped API string, safe to call from any thread
+    static QString decodeEntities(const QString& text);
+    //! One row per song in a single pass: tracks whose artist and title
+    //! match, ignoring case, spacing and punctuation, and whose durations
+    //! are close become variants of the first one, or of the one with the
+    //! best known bitrate
+    static void collapseDuplicates(PlaylistModel::Tracks& tracks);
+
+    //! Parses on the same pool as ingest(), but every reply gets a future
+    //! of its own, so a newer listing never supersedes it
+    QFuture<PlaylistModel::Tracks> read(const QByteArray& reply);
+
+signals:
+    void tracksReady(const PlaylistModel::Tracks& tracks);
+
+public slots:
+    void ingest(const QByteArray& reply, bool collapseDuplicates = false);
+
+private slots:
+    void deliver();
+
+private:
+    QThreadPool pool_;
+    QFutureWatcher<PlaylistModel::Tracks> watcher_;
+};
+
+#endif // PLAYLISTINGESTOR_H
@@ -0,0 +1,135 @@
+#include "playlistitemdelegate.h"
+#include "downloadmanager.h"
+#include "playlistmodel.h"
+
+#include <QAbstractProxyModel>
+#include <QApplication>
+#include <QPainter>
+#include <QStyle>
+
+static const int ROW_VERTICAL_PADDING = 6;
+static const int CELL_HORIZONTAL_PADDING = 4;
+static const int PROGRESS_BAR_HEIGHT = 2;
+
+static QFont boldFont(QFont font)
+{
+    font.setBold(true);
+    return font;
+}
+
+PlaylistItemDelegate::PlaylistItemDelegate(const QFont &font, QObject *parent) : QStyledItemDelegate(parent),
+    font_(font), boldFont_(boldFont(font)), metrics_(font_), boldMetrics_(boldFont_),
+    rowHeight_(qMax(metrics_.height(), boldMetrics_.height()) + ROW_VERTICAL_PADDING), downloads_(0)
+{
+}
+
+int PlaylistItemDelegate::rowHeight() const
+{
+    return rowHeight_;
+}
+
+void PlaylistItemDelegate::setDownloadManager(DownloadManager *downloads)
+{
+    downloads_ = downloads;
+}
+
+int PlaylistItemDelegate::columnWidth(int column) const
+{
+    switch (column) {
+    case PlaylistModel::Bitrate:
+        return metrics_.width("0000 kbps") + 2 * CELL_HORIZONTAL_PADDING;
+    case PlaylistModel::Size:
+        return metrics_.width("000.0 MB") + 2 * CELL_HORIZONTAL_PADDING;
+    case PlaylistModel::Duration:
+        return metrics_.width("00:00:00") + 2 * CELL_HORIZONTAL_PADDING;
+    default:
+        return 0;
+    }
+}
+
+void PlaylistItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    QModelIndex sourceIndex = index;
+    if (QAbstractProxyModel const * const proxy = qobject_cast<const QAbstractProxyModel*>(index.model()))
+        sourceIndex = proxy->mapToSource(index);
+
+    PlaylistModel const * const model = qobject_cast<const PlaylistModel*>(sourceIndex.model());
+    if (!model)
+    {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+
+    QStyle * const style = option.widget ? option.widget->style() : QApplication::style();
+    style->drawPrimitive(QStyle::PE_PanelItemViewItem, &option, painter, option.widget);
+
+    PlaylistModel::Track const& track = model->track(sourceIndex.row());
+    QRect const rect = option.rect.adjusted(CELL_HORIZONTAL_PADDING, 0, -CELL_HORIZONTAL_PADDING, 0);
+    bool const selected = option.state & QStyle::State_Selected;
+
+    painter->save();
+    painter->setPen(option.palette.color(QPalette::Normal, selected ? QPalette::HighlightedText : QPalette::Text));
+
+    switch (index.column()) {
+    case PlaylistModel::Artist:
+        painter->setFont(boldFont_);
+        painter->drawText(rect, Qt::AlignLeft | Qt::AlignVCenter,
+                          boldMetrics_.elidedText(track.artist, Qt::ElideRight, rect.width()));
+        break;
+    case PlaylistModel::Title:
+    {
+        QRect titleRect = rect;
+        painter->setFont(font_);
+
+        //! Collapsed uploads of the same song are counted after the title
+        if (!track.variants.isEmpty())
+        {
+            QString const variants = "+" + QString::number(track.variants.size());
+            QPen const pen = painter->pen();
+            painter->setPen(option.palette.color(QPalette::Disabled, selected ? QPalette::HighlightedText : QPalette::Text));
+            painter->drawText(rect, Qt::AlignRight | Qt::AlignVCenter, variants);
+            painter->setPen(pen);
+            titleRect.setRight(rect.right() - metrics_.width(variants) - CELL_HORIZONTAL_PADDING);
+        }
+
+        painter->drawText(titleRect, Qt::AlignLeft | Qt::AlignVCenter,
+                          metrics_.elidedText(track.title, Qt::ElideRight, titleRect.width()));
+        break;
+    }
+    case PlaylistModel::Bitrate:
+        painter->setFont(font_);
+        painter->setPen(option.palette.color(QPalette::Disabled, selected ? QPalette::HighlightedText : QPalette::Text));
+        painter->drawText(rect, Qt::AlignRight | Qt::AlignVCenter, PlaylistModel::formatBitrate(track.bitrate));
+        break;
+    case PlaylistModel::Size:
+    {
+        int const progress = downloads_ ? downloads_->progress(track.url) : -1;
+        painter->setFont(font_);
+        painter->setPen(option.palette.color(progress == 100 ? QPalette::Normal : QPalette::Disabled,
+                                             selected ? QPalette::HighlightedText : QPalette::Text));
+
+        if (progress >= 0 && progress < 100)
+        {
+            painter->drawText(rect, Qt::AlignRight | Qt::AlignVCenter, QString::number(progress) + "%");
+            painter->fillRect(rect.left(), option.rect.bottom() - PROGRESS_BAR_HEIGHT + 1, rect.width() * progress / 100,
+                              PROGRESS_BAR_HEIGHT, option.palette.color(QPalette::Highlight));
+        }
+        else
+            painter->drawText(rect, Qt::AlignRight | Qt::AlignVCenter, PlaylistModel::formatSize(track.size));
+        break;
+    }
+    case PlaylistModel::Duration:
+        painter->setFont(font_);
+        painter->drawText(rect, Qt::AlignRight | Qt::AlignVCenter, track.durationText);
+        break;
+    default:
+        break;
+    }
+
+    painter->restore();
+}
+
+QSize PlaylistItemDelegate::sizeHint(const QStyleOptionViewItem &/*option*/, const QModelIndex &index) const
+{
+    return QSize(columnWidth(index.column()), rowHeight_);
+}
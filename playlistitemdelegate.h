@@ -0,0 +1,37 @@
+#ifndef PLAYLISTITEMDELEGATE_H
+#define PLAYLISTITEMDELEGATE_H
+
+#include <QFont>
+#include <QFontMetrics>
+#include <QStyledItemDelegate>
+
+class DownloadManager;
+
+//! Paints playlist rows straight from PlaylistModel::Track with fonts and
+//! metrics computed once, so a scroll never queries per-item style roles
+class PlaylistItemDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    explicit PlaylistItemDelegate(const QFont& font, QObject *parent = 0);
+
+    int rowHeight() const;
+    int columnWidth(int column) const;
+
+    //! Pinned rows show their download progress in the size column
+    void setDownloadManager(DownloadManager *downloads);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem& option, const QModelIndex& index) const;
+    QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const;
+
+private:
+    QFont font_;
+    QFont boldFont_;
+    QFontMetrics metrics_;
+    QFontMetrics boldMetrics_;
+    int rowHeight_;
+    DownloadManager *downloads_;
+};
+
+#endif // PLAYLISTITEMDELEGATE_H
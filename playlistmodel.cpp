@@ -0,0 +1,563 @@
+#include "playlistmodel.h"
+#include "resourcemonitor.h"
+
+#include <QCollator>
+#include <QDataStream>
+#include <QDateTime>
+#include <QHash>
+#include <QMimeData>
+#include <QSet>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+static const int SORT_KEY_CHUNK_SIZE = 2048;
+static const char ROWS_MIME_TYPE[] = "application/x-flow-rows";
+//! Past this many displaced rows a refresh resets the view instead
+static const int RECONCILE_MOVE_LIMIT = 1000;
+
+namespace
+{
+
+struct SortKeyChunk
+{
+    int first;
+    int last;
+    std::vector<QCollatorSortKey> artistKeys;
+    std::vector<QCollatorSortKey> titleKeys;
+};
+
+QCollator sortKeyCollator()
+{
+    QCollator collator;
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    collator.setNumericMode(true);
+    return collator;
+}
+
+//! Duplicates of a key are told apart by their occurrence
+QVector<QString> uniqueKeys(const PlaylistModel::Tracks& tracks)
+{
+    QVector<QString> keys;
+    keys.reserve(tracks.size());
+    QHash<QString, int> occurrences;
+
+    foreach (const PlaylistModel::Track& track, tracks)
+    {
+        QString const key = PlaylistModel::trackKey(track);
+        int& occurrence = occurrences[key];
+        keys.append(occurrence == 0 ? key : key + '\n' + QString::number(occurrence));
+        ++occurrence;
+    }
+
+    return keys;
+}
+
+//! Marks one longest strictly increasing subsequence, O(n log n)
+QVector<bool> longestIncreasing(const QVector<int>& values)
+{
+    QVector<int> tails;
+    QVector<int> previous(values.size(), -1);
+
+    for (int i = 0; i < values.size(); ++i)
+    {
+        int const length = std::lower_bound(tails.begin(), tails.end(), i, [&values](int tail, int index)
+        {
+            return values.at(tail) < values.at(index);
+        }) - tails.begin();
+
+        if (length > 0)
+            previous[i] = tails.at(length - 1);
+
+        if (length == tails.size())
+            tails.append(i);
+        else
+            tails[length] = i;
+    }
+
+    QVector<bool> marked(values.size(), false);
+    for (int i = tails.isEmpty() ? -1 : tails.last(); i >= 0; i = previous.at(i))
+        marked[i] = true;
+
+    return marked;
+}
+
+template <typename Container>
+void moveRange(Container& container, int first, int count, int destination)
+{
+    if (destination > first)
+        std::rotate(container.begin() + first, container.begin() + first + count, container.begin() + destination);
+    else
+        std::rotate(container.begin() + destination, container.begin() + first, container.begin() + first + count);
+}
+
+}
+
+PlaylistModel::PlaylistModel(QObject *parent) : QAbstractTableModel(parent), movable_(false)
+{
+}
+
+PlaylistModel::~PlaylistModel()
+{
+    ResourceMonitor::adjust(ResourceMonitor::ModelRows, -tracks_.size());
+}
+
+int PlaylistModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : tracks_.size();
+}
+
+int PlaylistModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant PlaylistModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= tracks_.size())
+        return QVariant();
+
+    Track const& track = tracks_.at(index.row());
+
+    if (role == Qt::DisplayRole)
+    {
+        switch (index.column()) {
+        case Artist:
+            return track.artist;
+        case Title:
+            return track.title;
+        case Bitrate:
+            return formatBitrate(track.bitrate);
+        case Size:
+            return formatSize(track.size);
+        case Duration:
+            return track.durationText;
+        default:
+            break;
+        }
+    }
+    else if (role == Qt::TextAlignmentRole && index.column() >= Bitrate)
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+
+    return QVariant();
+}
+
+Qt::ItemFlags PlaylistModel::flags(const QModelIndex &index) const
+{
+    Qt::ItemFlags flags = QAbstractTableModel::flags(index);
+    if (!movable_)
+        return flags;
+
+    //! Drops land between rows, never on one
+    return index.isValid() ? flags | Qt::ItemIsDragEnabled : flags | Qt::ItemIsDropEnabled;
+}
+
+Qt::DropActions PlaylistModel::supportedDropActions() const
+{
+    return movable_ ? Qt::MoveAction : Qt::IgnoreAction;
+}
+
+QStringList PlaylistModel::mimeTypes() const
+{
+    return QStringList() << ROWS_MIME_TYPE;
+}
+
+QMimeData *PlaylistModel::mimeData(const QModelIndexList &indexes) const
+{
+    QVector<int> rows;
+    foreach (const QModelIndex& index, indexes)
+    {
+        if (index.isValid() && !rows.contains(index.row()))
+            rows.append(index.row());
+    }
+
+    QByteArray encoded;
+    QDataStream stream(&encoded, QIODevice::WriteOnly);
+    stream << rows;
+
+    QMimeData * const data = new QMimeData;
+    data->setData(ROWS_MIME_TYPE, encoded);
+    return data;
+}
+
+bool PlaylistModel::dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int /*column*/,
+                                 const QModelIndex &parent)
+{
+    if (!movable_ || action != Qt::MoveAction || !data->hasFormat(ROWS_MIME_TYPE))
+        return false;
+
+    QVector<int> rows;
+    QDataStream stream(data->data(ROWS_MIME_TYPE));
+    stream >> rows;
+
+    int destination = row >= 0 ? row : parent.isValid() ? parent.row() : tracks_.size();
+    emit moveRequested(rows, qBound(0, destination, tracks_.size()));
+
+    //! Declined, so the view does not remove the dragged rows itself
+    return false;
+}
+
+void PlaylistModel::setMovable(bool movable)
+{
+    movable_ = movable;
+}
+
+const PlaylistModel::Track &PlaylistModel::track(int row) const
+{
+    return tracks_.at(row);
+}
+
+const PlaylistModel::Tracks &PlaylistModel::tracks() const
+{
+    return tracks_;
+}
+
+void PlaylistModel::setTrackInfo(int row, int bitrate, qint64 size)
+{
+    if (row < 0 || row >= tracks_.size())
+        return;
+
+    Track& track = tracks_[row];
+    track.bitrate = bitrate;
+    track.size = size;
+    emit dataChanged(index(row, Bitrate), index(row, Size));
+}
+
+void PlaylistModel::setTrackUrl(int row, const QUrl &url, qint64 signedAt)
+{
+    if (row < 0 || row >= tracks_.size())
+        return;
+
+    tracks_[row].url = url;
+    tracks_[row].signedAt = signedAt;
+}
+
+void PlaylistModel::expandVariants(int row)
+{
+    if (row < 0 || row >= tracks_.size() || tracks_.at(row).variants.isEmpty())
+        return;
+
+    Tracks variants;
+    variants.swap(tracks_[row].variants);
+    emit dataChanged(index(row, Title), index(row, Title));
+
+    insertTracks(row + 1, variants);
+}
+
+bool PlaylistModel::lessThan(int column, int left, int right) const
+{
+    QCollatorSortKey const& leftArtist = artistKeys_[left];
+    QCollatorSortKey const& rightArtist = artistKeys_[right];
+    QCollatorSortKey const& leftTitle = titleKeys_[left];
+    QCollatorSortKey const& rightTitle = titleKeys_[right];
+
+    if (column == Title)
+    {
+        int const order = leftTitle.compare(rightTitle);
+        return order != 0 ? order < 0 : leftArtist.compare(rightArtist) < 0;
+    }
+
+    if (column == Duration)
+    {
+        int const leftDuration = tracks_.at(left).duration;
+        int const rightDuration = tracks_.at(right).duration;
+        if (leftDuration != rightDuration)
+            return leftDuration < rightDuration;
+    }
+
+    int const order = leftArtist.compare(rightArtist);
+    return order != 0 ? order < 0 : leftTitle.compare(rightTitle) < 0;
+}
+
+QString PlaylistModel::trackKey(const PlaylistModel::Track &track)
+{
+    return track.id.isEmpty() ? streamKey(track.url) : track.id;
+}
+
+QString PlaylistModel::streamKey(const QUrl &url)
+{
+    return url.adjusted(QUrl::RemoveQuery | QUrl::RemoveFragment).toString();
+}
+
+QString PlaylistModel::formatDuration(int seconds)
+{
+    QString const format = seconds >= 3600 ? "hh:mm:ss" :"mm:ss";
+    return QDateTime::fromTime_t(seconds).toUTC().toString(format);
+}
+
+QString PlaylistModel::formatBitrate(int bitrate)
+{
+    return bitrate > 0 ? QString::number(bitrate) + " kbps" : QString();
+}
+
+QString PlaylistModel::formatSize(qint64 size)
+{
+    return size > 0 ? QString::number(size / (1024.0 * 1024.0), 'f', 1) + " MB" : QString();
+}
+
+void PlaylistModel::setTracks(const PlaylistModel::Tracks &tracks)
+{
+    ResourceMonitor::adjust(ResourceMonitor::ModelRows, tracks.size() - tracks_.size());
+
+    beginResetModel();
+    tracks_ = tracks;
+    artistKeys_.clear();
+    titleKeys_.clear();
+    insertSortKeys(0, tracks_.size());
+    endResetModel();
+}
+
+void PlaylistModel::appendTracks(const PlaylistModel::Tracks &tracks)
+{
+    insertTracks(tracks_.size(), tracks);
+}
+
+void PlaylistModel::insertTracks(int row, const PlaylistModel::Tracks &tracks)
+{
+    Q_ASSERT(row >= 0 && row <= tracks_.size());
+
+    if (tracks.isEmpty())
+        return;
+
+    beginInsertRows(QModelIndex(), row, row + tracks.size() - 1);
+    if (row == tracks_.size())
+        tracks_ += tracks;
+    else
+    {
+        tracks_.insert(row, tracks.size(), Track());
+        std::copy(tracks.begin(), tracks.end(), tracks_.begin() + row);
+    }
+    insertSortKeys(row, tracks.size());
+    endInsertRows();
+
+    ResourceMonitor::adjust(ResourceMonitor::ModelRows, tracks.size());
+}
+
+void PlaylistModel::removeTracks(int first, int count)
+{
+    Q_ASSERT(first >= 0 && first + count <= tracks_.size());
+
+    if (count <= 0)
+        return;
+
+    beginRemoveRows(QModelIndex(), first, first + count - 1);
+    tracks_.remove(first, count);
+    artistKeys_.erase(artistKeys_.begin() + first, artistKeys_.begin() + first + count);
+    titleKeys_.erase(titleKeys_.begin() + first, titleKeys_.begin() + first + count);
+    endRemoveRows();
+
+    ResourceMonitor::adjust(ResourceMonitor::ModelRows, -count);
+}
+
+void PlaylistModel::moveTracks(int first, int count, int destination)
+{
+    Q_ASSERT(first >= 0 && first + count <= tracks_.size() && destination >= 0 && destination <= tracks_.size());
+
+    if (count <= 0 || (destination >= first && destination <= first + count))
+        return;
+
+    beginMoveRows(QModelIndex(), first, first + count - 1, QModelIndex(), destination);
+    moveRange(tracks_, first, count, destination);
+    moveRange(artistKeys_, first, count, destination);
+    moveRange(titleKeys_, first, count, destination);
+    endMoveRows();
+}
+
+void PlaylistModel::clear()
+{
+    if (tracks_.isEmpty())
+        return;
+
+    ResourceMonitor::adjust(ResourceMonitor::ModelRows, -tracks_.size());
+
+    beginResetModel();
+    tracks_.clear();
+    std::vector<QCollatorSortKey>().swap(artistKeys_);
+    std::vector<QCollatorSortKey>().swap(titleKeys_);
+    endResetModel();
+}
+
+bool PlaylistModel::reconcile(const PlaylistModel::Tracks &tracks)
+{
+    QVector<QString> const oldKeys = uniqueKeys(tracks_);
+    QVector<QString> const newKeys = uniqueKeys(tracks);
+
+    //! The common refresh: same tracks in the same order
+    if (oldKeys == newKeys)
+        return updateRows(tracks);
+
+    QHash<QString, int> newRows;
+    newRows.reserve(newKeys.size());
+    for (int row = 0; row < newKeys.size(); ++row)
+        newRows.insert(newKeys.at(row), row);
+
+    QVector<int> targets(oldKeys.size());
+    bool anyKept = false;
+    for (int row = 0; row < oldKeys.size(); ++row)
+    {
+        targets[row] = newRows.value(oldKeys.at(row), -1);
+        anyKept = anyKept || targets.at(row) >= 0;
+    }
+
+    if (!anyKept)
+    {
+        setTracks(tracks);
+        return true;
+    }
+
+    for (int last = targets.size() - 1; last >= 0; --last)
+    {
+        if (targets.at(last) >= 0)
+            continue;
+
+        int first = last;
+        while (first > 0 && targets.at(first - 1) < 0)
+            --first;
+
+        int const count = last - first + 1;
+        targets.remove(first, count);
+        removeTracks(first, count);
+        last = first;
+    }
+
+    //! Rows on a longest increasing run of targets stay where they are. The
+    //! others are taken in target order and go right after the row with the
+    //! preceding target; rows that are already adjacent move together
+    QVector<bool> const kept = longestIncreasing(targets);
+    if (kept.count(false) > RECONCILE_MOVE_LIMIT)
+    {
+        setTracks(tracks);
+        return true;
+    }
+
+    QVector<int> byTarget(newKeys.size(), -1);
+    QVector<int> position(targets.size());
+    QVector<int> order(targets.size());
+    for (int row = 0; row < targets.size(); ++row)
+    {
+        byTarget[targets.at(row)] = row;
+        position[row] = row;
+        order[row] = row;
+    }
+    byTarget.removeAll(-1);
+
+    for (int first = 0; first < byTarget.size(); ++first)
+    {
+        if (kept.at(byTarget.at(first)))
+            continue;
+
+        int const from = position.at(byTarget.at(first));
+        int last = first;
+        while (last + 1 < byTarget.size() && !kept.at(byTarget.at(last + 1)) &&
+               position.at(byTarget.at(last + 1)) == from + last + 1 - first)
+            ++last;
+
+        int const count = last - first + 1;
+        int const destination = first == 0 ? 0 : position.at(byTarget.at(first - 1)) + 1;
+        if (destination < from || destination > from + count)
+        {
+            moveTracks(from, count, destination);
+            moveRange(order, from, count, destination);
+            for (int row = qMin(from, destination); row < qMax(from + count, destination); ++row)
+                position[order.at(row)] = row;
+        }
+
+        first = last;
+    }
+
+    QSet<QString> const oldKeySet = QSet<QString>::fromList(oldKeys.toList());
+    for (int first = 0; first < newKeys.size(); ++first)
+    {
+        if (oldKeySet.contains(newKeys.at(first)))
+            continue;
+
+        int last = first;
+        while (last + 1 < newKeys.size() && !oldKeySet.contains(newKeys.at(last + 1)))
+            ++last;
+
+        insertTracks(first, tracks.mid(first, last - first + 1));
+        first = last;
+    }
+
+    updateRows(tracks);
+    return true;
+}
+
+void PlaylistModel::insertSortKeys(int first, int count)
+{
+    QVector<SortKeyChunk> chunks;
+    for (int row = first; row < first + count; row += SORT_KEY_CHUNK_SIZE)
+    {
+        SortKeyChunk chunk;
+        chunk.first = row;
+        chunk.last = qMin(row + SORT_KEY_CHUNK_SIZE, first + count);
+        chunks.append(chunk);
+    }
+
+    //! QCollator is not shared between threads, every chunk gets its own
+    Tracks const& tracks = tracks_;
+    QtConcurrent::blockingMap(chunks, [&tracks](SortKeyChunk& chunk)
+    {
+        QCollator const collator = sortKeyCollator();
+
+        chunk.artistKeys.reserve(chunk.last - chunk.first);
+        chunk.titleKeys.reserve(chunk.last - chunk.first);
+        for (int row = chunk.first; row < chunk.last; ++row)
+        {
+            chunk.artistKeys.push_back(collator.sortKey(tracks.at(row).artist));
+            chunk.titleKeys.push_back(collator.sortKey(tracks.at(row).title));
+        }
+    });
+
+    artistKeys_.reserve(tracks_.size());
+    titleKeys_.reserve(tracks_.size());
+    int position = first;
+    foreach (const SortKeyChunk& chunk, chunks)
+    {
+        artistKeys_.insert(artistKeys_.begin() + position, chunk.artistKeys.begin(), chunk.artistKeys.end());
+        titleKeys_.insert(titleKeys_.begin() + position, chunk.titleKeys.begin(), chunk.titleKeys.end());
+        position += chunk.last - chunk.first;
+    }
+}
+
+bool PlaylistModel::updateRows(const PlaylistModel::Tracks &tracks)
+{
+    Q_ASSERT(tracks.size() == tracks_.size());
+
+    bool changed = false;
+
+    for (int row = 0; row < tracks_.size(); ++row)
+    {
+        Track& track = tracks_[row];
+        Track const& update = tracks.at(row);
+
+        bool const textChanged = track.artist != update.artist || track.title != update.title;
+        bool const shownChanged = textChanged || track.durationText != update.durationText ||
+                (update.isProbed() && (track.bitrate != update.bitrate || track.size != update.size));
+
+        //! Stream urls are re-signed on every listing; probe results stay
+        int const bitrate = track.bitrate;
+        qint64 const size = track.size;
+        track = update;
+        if (!track.isProbed())
+        {
+            track.bitrate = bitrate;
+            track.size = size;
+        }
+
+        if (textChanged)
+        {
+            QCollator const collator = sortKeyCollator();
+            artistKeys_[row] = collator.sortKey(track.artist);
+            titleKeys_[row] = collator.sortKey(track.title);
+        }
+
+        if (shownChanged)
+        {
+            changed = true;
+            emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+        }
+    }
+
+    return changed;
+}
@@ -0,0 +1,121 @@
+#ifndef PLAYLISTMODEL_H
+#define PLAYLISTMODEL_H
+
+#include <QAbstractTableModel>
+#include <QCollatorSortKey>
+#include <QUrl>
+#include <QVector>
+
+#include <vector>
+
+class PlaylistModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column
+    {
+        Artist,
+        Title,
+        Bitrate,
+        Size,
+        Duration,
+        ColumnCount
+    };
+
+    //! Row data, already decoded and formatted for painting
+    struct Track
+    {
+        //! owner_aid for API tracks, empty for local files
+        QString id;
+        QString artist;
+        QString title;
+        int duration;
+        QString durationText;
+        QUrl url;
+        //! When the url was signed, ms since the epoch; 0 for local files
+        qint64 signedAt;
+        int bitrate;
+        qint64 size;
+        //! Other uploads of the same song, collapsed into this row
+        QVector<Track> variants;
+
+        Track() : duration(0), signedAt(0), bitrate(0), size(0) {}
+
+        bool isProbed() const { return size != 0; }
+    };
+
+    typedef QVector<Track> Tracks;
+
+    explicit PlaylistModel(QObject *parent = 0);
+    ~PlaylistModel();
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
+    Qt::ItemFlags flags(const QModelIndex& index) const;
+    Qt::DropActions supportedDropActions() const;
+    QStringList mimeTypes() const;
+    QMimeData * mimeData(const QModelIndexList& indexes) const;
+    bool dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column, const QModelIndex& parent);
+
+    //! Rows of a movable model can be dragged around; the drop is only
+    //! reported through moveRequested so the owner can move what mirrors them
+    void setMovable(bool movable);
+
+    const Track& track(int row) const;
+    const Tracks& tracks() const;
+
+    void setTrackInfo(int row, int bitrate, qint64 size);
+    //! Urls are not shown, so no row is repainted
+    void setTrackUrl(int row, const QUrl& url, qint64 signedAt);
+    //! The collapsed uploads of row become rows of their own right below it
+    void expandVariants(int row);
+
+    //! Artist, Title and Duration order; ties fall back to the other text column
+    bool lessThan(int column, int left, int right) const;
+
+    //! Identity of a track across refreshes: the API id, or the url
+    //! without its signature
+    static QString trackKey(const Track& track);
+    //! Stream urls are signed, so only the url without query and fragment
+    //! stays the same for a track; every cache keyed by url uses this
+    static QString streamKey(const QUrl& url);
+
+    static QString formatDuration(int seconds);
+    static QString formatBitrate(int bitrate);
+    static QString formatSize(qint64 size);
+
+    void setTracks(const Tracks& tracks);
+    void appendTracks(const Tracks& tracks);
+    void insertTracks(int row, const Tracks& tracks);
+    void removeTracks(int first, int count);
+    //! Rows [first, first + count) go in front of destination, as in beginMoveRows
+    void moveTracks(int first, int count, int destination);
+    void clear();
+
+    //! Brings the rows in line with tracks through removes, moves and
+    //! inserts of single runs, matched by trackKey; existing rows keep their
+    //! probe results. A list without any common track, or with too many
+    //! displaced ones, replaces the model with a reset. Returns false when
+    //! nothing visible changed.
+    bool reconcile(const Tracks& tracks);
+
+signals:
+    void moveRequested(const QVector<int>& rows, int destination);
+
+private:
+    void insertSortKeys(int first, int count);
+    bool updateRows(const Tracks& tracks);
+
+    Tracks tracks_;
+    bool movable_;
+    //! Collation keys are computed once per track when it enters the model
+    std::vector<QCollatorSortKey> artistKeys_;
+    std::vector<QCollatorSortKey> titleKeys_;
+};
+
+Q_DECLARE_METATYPE(PlaylistModel::Tracks)
+
+#endif // PLAYLISTMODEL_H
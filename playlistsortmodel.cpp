@@ -0,0 +1,418 @@
+#include "playlistsortmodel.h"
+
+#include <QThread>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+static const int PARALLEL_SORT_MIN_CHUNK = 4096;
+
+namespace
+{
+
+struct SortRange
+{
+    int first;
+    int middle;
+    int last;
+};
+
+//! Stable-sorts one chunk per core, then merges neighbouring chunks in
+//! parallel rounds until a single run is left
+template <typename LessThan>
+void parallelStableSort(QVector<int>& rows, LessThan lessThan)
+{
+    int const count = rows.size();
+    int const chunkCount = qMin(QThread::idealThreadCount(), count / PARALLEL_SORT_MIN_CHUNK);
+
+    if (chunkCount < 2)
+    {
+        std::stable_sort(rows.begin(), rows.end(), lessThan);
+        return;
+    }
+
+    int * const data = rows.data();
+
+    QVector<SortRange> runs;
+    for (int i = 0; i < chunkCount; ++i)
+    {
+        SortRange run;
+        run.first = qint64(count) * i / chunkCount;
+        run.middle = run.first;
+        run.last = qint64(count) * (i + 1) / chunkCount;
+        runs.append(run);
+    }
+
+    QtConcurrent::blockingMap(runs, [data, lessThan](const SortRange& run)
+    {
+        std::stable_sort(data + run.first, data + run.last, lessThan);
+    });
+
+    while (runs.size() > 1)
+    {
+        QVector<SortRange> merges;
+        QVector<SortRange> next;
+
+        for (int i = 0; i + 1 < runs.size(); i += 2)
+        {
+            SortRange merge;
+            merge.first = runs.at(i).first;
+            merge.middle = runs.at(i).last;
+            merge.last = runs.at(i + 1).last;
+            merges.append(merge);
+            next.append(merge);
+        }
+
+        if (runs.size() % 2 == 1)
+            next.append(runs.last());
+
+        QtConcurrent::blockingMap(merges, [data, lessThan](const SortRange& merge)
+        {
+            std::inplace_merge(data + merge.first, data + merge.middle, data + merge.last, lessThan);
+        });
+
+        runs = next;
+    }
+}
+
+}
+
+PlaylistSortModel::PlaylistSortModel(QObject *parent) : QAbstractProxyModel(parent),
+    model_(0), sortColumn_(-1), sortOrder_(Qt::AscendingOrder)
+{
+}
+
+void PlaylistSortModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    PlaylistModel * const model = qobject_cast<PlaylistModel*>(sourceModel);
+    Q_ASSERT(model || !sourceModel);
+
+    if (model == model_)
+        return;
+
+    beginResetModel();
+
+    if (model_)
+        disconnect(model_, 0, this, 0);
+
+    QAbstractProxyModel::setSourceModel(model);
+    model_ = model;
+
+    if (model_)
+    {
+        connect(model_, &PlaylistModel::modelAboutToBeReset, this, &PlaylistSortModel::beginSourceReset);
+        connect(model_, &PlaylistModel::modelReset, this, &PlaylistSortModel::endSourceReset);
+        connect(model_, &PlaylistModel::rowsAboutToBeInserted, this, &PlaylistSortModel::beginSourceInsert);
+        connect(model_, &PlaylistModel::rowsInserted, this, &PlaylistSortModel::endSourceInsert);
+        connect(model_, &PlaylistModel::rowsAboutToBeRemoved, this, &PlaylistSortModel::beginSourceRemove);
+        connect(model_, &PlaylistModel::rowsRemoved, this, &PlaylistSortModel::endSourceRemove);
+        connect(model_, &PlaylistModel::rowsAboutToBeMoved, this, &PlaylistSortModel::beginSourceMove);
+        connect(model_, &PlaylistModel::rowsMoved, this, &PlaylistSortModel::endSourceMove);
+        connect(model_, &PlaylistModel::dataChanged, this, &PlaylistSortModel::forwardDataChanged);
+    }
+
+    resetOrder();
+    applySort();
+    endResetModel();
+}
+
+PlaylistModel *PlaylistSortModel::playlistModel() const
+{
+    return model_;
+}
+
+QModelIndex PlaylistSortModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (parent.isValid() || row < 0 || row >= sourceRows_.size() || column < 0 || column >= columnCount())
+        return QModelIndex();
+
+    return createIndex(row, column);
+}
+
+QModelIndex PlaylistSortModel::parent(const QModelIndex &/*child*/) const
+{
+    return QModelIndex();
+}
+
+int PlaylistSortModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : sourceRows_.size();
+}
+
+int PlaylistSortModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() || !model_ ? 0 : model_->columnCount();
+}
+
+QModelIndex PlaylistSortModel::mapToSource(const QModelIndex &proxyIndex) const
+{
+    if (!model_ || !proxyIndex.isValid() || proxyIndex.row() >= sourceRows_.size())
+        return QModelIndex();
+
+    return model_->index(sourceRows_.at(proxyIndex.row()), proxyIndex.column());
+}
+
+QModelIndex PlaylistSortModel::mapFromSource(const QModelIndex &sourceIndex) const
+{
+    if (!sourceIndex.isValid() || sourceIndex.row() >= proxyRows_.size() || proxyRows_.at(sourceIndex.row()) < 0)
+        return QModelIndex();
+
+    return index(proxyRows_.at(sourceIndex.row()), sourceIndex.column());
+}
+
+void PlaylistSortModel::sort(int column, Qt::SortOrder order)
+{
+    if (column != PlaylistModel::Artist && column != PlaylistModel::Title && column != PlaylistModel::Duration)
+        column = -1;
+
+    if (column == sortColumn_ && order == sortOrder_)
+        return;
+
+    sortColumn_ = column;
+    sortOrder_ = order;
+    relayout();
+}
+
+int PlaylistSortModel::sortColumn() const
+{
+    return sortColumn_;
+}
+
+Qt::SortOrder PlaylistSortModel::sortOrder() const
+{
+    return sortOrder_;
+}
+
+PlaylistModel::Tracks PlaylistSortModel::sortedTracks() const
+{
+    if (!model_)
+        return PlaylistModel::Tracks();
+
+    if (sortColumn_ < 0)
+        return model_->tracks();
+
+    PlaylistModel::Tracks tracks;
+    tracks.reserve(sourceRows_.size());
+    foreach (int row, sourceRows_)
+        tracks.append(model_->track(row));
+
+    return tracks;
+}
+
+void PlaylistSortModel::beginSourceReset()
+{
+    beginResetModel();
+}
+
+void PlaylistSortModel::endSourceReset()
+{
+    resetOrder();
+    applySort();
+    endResetModel();
+}
+
+void PlaylistSortModel::beginSourceInsert(const QModelIndex &/*parent*/, int first, int last)
+{
+    //! Unsorted rows go where the source puts them; sorted ones show up at
+    //! the end and are moved into place by the relayout that follows
+    if (sortColumn_ < 0)
+        beginInsertRows(QModelIndex(), first, last);
+    else
+        beginInsertRows(QModelIndex(), sourceRows_.size(), sourceRows_.size() + last - first);
+}
+
+void PlaylistSortModel::endSourceInsert(const QModelIndex &/*parent*/, int first, int last)
+{
+    if (sortColumn_ < 0)
+    {
+        resetOrder();
+        endInsertRows();
+        return;
+    }
+
+    int const count = last - first + 1;
+    for (int i = 0; i < sourceRows_.size(); ++i)
+    {
+        if (sourceRows_.at(i) >= first)
+            sourceRows_[i] += count;
+    }
+
+    for (int row = first; row <= last; ++row)
+        sourceRows_.append(row);
+
+    updateProxyRows();
+    endInsertRows();
+    relayout();
+}
+
+void PlaylistSortModel::beginSourceRemove(const QModelIndex &/*parent*/, int first, int last)
+{
+    if (sortColumn_ < 0)
+    {
+        beginRemoveRows(QModelIndex(), first, last);
+        return;
+    }
+
+    //! Sorted, the removed rows are scattered; drop them in runs from the bottom
+    QVector<int> removed;
+    for (int row = first; row <= last; ++row)
+        removed.append(proxyRows_.at(row));
+    std::sort(removed.begin(), removed.end());
+
+    for (int end = removed.size() - 1; end >= 0; --end)
+    {
+        int begin = end;
+        while (begin > 0 && removed.at(begin - 1) == removed.at(begin) - 1)
+            --begin;
+
+        beginRemoveRows(QModelIndex(), removed.at(begin), removed.at(end));
+        sourceRows_.remove(removed.at(begin), end - begin + 1);
+        updateProxyRows();
+        endRemoveRows();
+
+        end = begin;
+    }
+}
+
+void PlaylistSortModel::endSourceRemove(const QModelIndex &/*parent*/, int first, int last)
+{
+    if (sortColumn_ < 0)
+    {
+        resetOrder();
+        endRemoveRows();
+        return;
+    }
+
+    int const count = last - first + 1;
+    for (int i = 0; i < sourceRows_.size(); ++i)
+    {
+        if (sourceRows_.at(i) > last)
+            sourceRows_[i] -= count;
+    }
+
+    updateProxyRows();
+}
+
+void PlaylistSortModel::beginSourceMove(const QModelIndex &/*parent*/, int first, int last,
+                                        const QModelIndex &/*destinationParent*/, int destination)
+{
+    if (sortColumn_ < 0)
+        beginMoveRows(QModelIndex(), first, last, QModelIndex(), destination);
+}
+
+void PlaylistSortModel::endSourceMove(const QModelIndex &/*parent*/, int first, int last,
+                                      const QModelIndex &/*destinationParent*/, int destination)
+{
+    if (sortColumn_ < 0)
+    {
+        resetOrder();
+        endMoveRows();
+        return;
+    }
+
+    //! Sorted rows keep their place; only the source rows they map to shift
+    int const count = last - first + 1;
+    for (int i = 0; i < sourceRows_.size(); ++i)
+    {
+        int& row = sourceRows_[i];
+        if (destination > last)
+        {
+            if (row >= first && row <= last)
+                row += destination - last - 1;
+            else if (row > last && row < destination)
+                row -= count;
+        }
+        else if (destination < first)
+        {
+            if (row >= first && row <= last)
+                row -= first - destination;
+            else if (row >= destination && row < first)
+                row += count;
+        }
+    }
+
+    updateProxyRows();
+}
+
+void PlaylistSortModel::forwardDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
+{
+    for (int row = topLeft.row(); row <= bottomRight.row() && row < proxyRows_.size(); ++row)
+    {
+        int const proxyRow = proxyRows_.at(row);
+        emit dataChanged(index(proxyRow, topLeft.column()), index(proxyRow, bottomRight.column()), roles);
+    }
+}
+
+void PlaylistSortModel::resetOrder()
+{
+    int const count = model_ ? model_->rowCount() : 0;
+
+    sourceRows_.resize(count);
+    for (int row = 0; row < count; ++row)
+        sourceRows_[row] = row;
+
+    proxyRows_ = sourceRows_;
+}
+
+void PlaylistSortModel::updateProxyRows()
+{
+    //! Rows the source is about to remove map to nothing
+    proxyRows_.fill(-1, model_ ? model_->rowCount() : 0);
+    for (int row = 0; row < sourceRows_.size(); ++row)
+        proxyRows_[sourceRows_.at(row)] = row;
+}
+
+void PlaylistSortModel::applySort()
+{
+    if (!model_ || sortColumn_ < 0)
+    {
+        resetOrder();
+        return;
+    }
+
+    PlaylistModel const * const model = model_;
+    int const column = sortColumn_;
+
+    if (sortOrder_ == Qt::AscendingOrder)
+    {
+        parallelStableSort(sourceRows_, [model, column](int left, int right)
+        {
+            return model->lessThan(column, left, right);
+        });
+    }
+    else
+    {
+        parallelStableSort(sourceRows_, [model, column](int left, int right)
+        {
+            return model->lessThan(column, right, left);
+        });
+    }
+
+    for (int row = 0; row < sourceRows_.size(); ++row)
+        proxyRows_[sourceRows_.at(row)] = row;
+}
+
+void PlaylistSortModel::relayout()
+{
+    emit layoutAboutToBeChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+
+    QModelIndexList const persistent = persistentIndexList();
+    QVector<int> persistentSourceRows;
+    persistentSourceRows.reserve(persistent.size());
+    foreach (const QModelIndex& index, persistent)
+        persistentSourceRows.append(sourceRows_.at(index.row()));
+
+    if (sortColumn_ < 0)
+        resetOrder();
+    else
+        applySort();
+
+    QModelIndexList updated;
+    updated.reserve(persistent.size());
+    for (int i = 0; i < persistent.size(); ++i)
+        updated.append(index(proxyRows_.at(persistentSourceRows.at(i)), persistent.at(i).column()));
+
+    changePersistentIndexList(persistent, updated);
+
+    emit layoutChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+}
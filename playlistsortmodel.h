@@ -0,0 +1,60 @@
+#ifndef PLAYLISTSORTMODEL_H
+#define PLAYLISTSORTMODEL_H
+
+#include "playlistmodel.h"
+
+#include <QAbstractProxyModel>
+#include <QVector>
+
+//! Sorted view of a PlaylistModel: only a row permutation is kept, the
+//! tracks stay in the source model and are never copied
+class PlaylistSortModel : public QAbstractProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit PlaylistSortModel(QObject *parent = 0);
+
+    void setSourceModel(QAbstractItemModel *sourceModel);
+    PlaylistModel * playlistModel() const;
+
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const;
+    QModelIndex parent(const QModelIndex& child) const;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+
+    QModelIndex mapToSource(const QModelIndex& proxyIndex) const;
+    QModelIndex mapFromSource(const QModelIndex& sourceIndex) const;
+
+    //! Artist, Title and Duration are sortable; any other column restores the source order
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+    int sortColumn() const;
+    Qt::SortOrder sortOrder() const;
+
+    PlaylistModel::Tracks sortedTracks() const;
+
+private slots:
+    void beginSourceReset();
+    void endSourceReset();
+    void beginSourceInsert(const QModelIndex& parent, int first, int last);
+    void endSourceInsert(const QModelIndex& parent, int first, int last);
+    void beginSourceRemove(const QModelIndex& parent, int first, int last);
+    void endSourceRemove(const QModelIndex& parent, int first, int last);
+    void beginSourceMove(const QModelIndex& parent, int first, int last, const QModelIndex& destinationParent, int destination);
+    void endSourceMove(const QModelIndex& parent, int first, int last, const QModelIndex& destinationParent, int destination);
+    void forwardDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& roles);
+
+private:
+    void resetOrder();
+    void updateProxyRows();
+    void applySort();
+    void relayout();
+
+    PlaylistModel *model_;
+    QVector<int> sourceRows_;
+    QVector<int> proxyRows_;
+    int sortColumn_;
+    Qt::SortOrder sortOrder_;
+};
+
+#endif // PLAYLISTSORTMODEL_H
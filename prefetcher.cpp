@@ -0,0 +1,130 @@
+#include "prefetcher.h"
+#include "coverartscanner.h"
+#include "playlistmodel.h"
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+static const qint64 DEFAULT_CHUNK_SIZE = 256 * 1024;
+//! Enough for a few quick picks in a row, then one track every 10 s
+static const double BUDGET_BURST = 4.0 * DEFAULT_CHUNK_SIZE;
+static const double BUDGET_REFILL_PER_SECOND = DEFAULT_CHUNK_SIZE / 10.0;
+static const int RECENT_PREFETCH_COUNT = 32;
+
+Prefetcher::Prefetcher(QNetworkAccessManager *networkManager, QObject *parent) : QObject(parent),
+    networkManager_(networkManager), reply_(0), chunkSize_(DEFAULT_CHUNK_SIZE), headSize_(DEFAULT_CHUNK_SIZE),
+    budget_(BUDGET_BURST)
+{
+    Q_ASSERT(networkManager);
+
+    refillClock_.start();
+}
+
+void Prefetcher::setChunkSize(qint64 chunkSize)
+{
+    Q_ASSERT(chunkSize > 0);
+    chunkSize_ = chunkSize;
+}
+
+void Prefetcher::prefetch(const QUrl &url)
+{
+    QString const key = cacheKey(url);
+    if (reply_ && cacheKey(reply_->url()) == key)
+        return;
+
+    cancel();
+
+    if (url.isEmpty() || url.isLocalFile() || recent_.contains(key))
+        return;
+
+    refillBudget();
+    if (budget_ < chunkSize_)
+        return;
+
+    budget_ -= chunkSize_;
+    recent_.append(key);
+    if (recent_.size() > RECENT_PREFETCH_COUNT)
+        recent_.removeFirst();
+
+    QNetworkRequest request(url);
+    request.setPriority(QNetworkRequest::LowPriority);
+    request.setRawHeader("Range", "bytes=0-" + QByteArray::number(chunkSize_ - 1));
+
+    reply_ = networkManager_->get(request);
+    headSize_ = chunkSize_;
+    transferTimer_.start();
+    connect(reply_, &QNetworkReply::readyRead, this, &Prefetcher::readHead);
+    connect(reply_, &QNetworkReply::finished, this, &Prefetcher::finishPrefetch);
+}
+
+void Prefetcher::cancel()
+{
+    if (!reply_)
+        return;
+
+    QNetworkReply * const reply = reply_;
+    reply_ = 0;
+    reply->abort();
+    reply->deleteLater();
+
+    //! An aborted track may be prefetched again when it comes back
+    recent_.removeAll(cacheKey(reply->url()));
+}
+
+void Prefetcher::readHead()
+{
+    if (!reply_ || sender() != reply_ || reply_->bytesAvailable() < CoverArtScanner::Id3v2HeaderSize)
+        return;
+
+    //! Only the tag holds a cover; without one there is nothing more to get
+    if (headSize_ == chunkSize_)
+    {
+        QByteArray const header = reply_->peek(CoverArtScanner::Id3v2HeaderSize);
+        qint64 const tagSize = CoverArtScanner::id3v2Size(header.constData(), header.size());
+        headSize_ = tagSize > 0 ? qMin(chunkSize_, tagSize) : CoverArtScanner::Id3v2HeaderSize;
+    }
+
+    //! A server that ignores the range would send the whole file
+    if (reply_->bytesAvailable() >= headSize_)
+        complete();
+}
+
+void Prefetcher::finishPrefetch()
+{
+    if (reply_ && sender() == reply_)
+        complete();
+}
+
+void Prefetcher::complete()
+{
+    QNetworkReply * const reply = reply_;
+    reply_ = 0;
+    disconnect(reply, 0, this, 0);
+
+    QUrl const url = reply->url();
+    bool const succeeded = reply->error() == QNetworkReply::NoError;
+    QByteArray const head = reply->read(headSize_);
+    reply->abort();
+    reply->deleteLater();
+
+    //! The budget was charged for a whole chunk
+    budget_ = qMin(BUDGET_BURST, budget_ + chunkSize_ - head.size());
+
+    if (!succeeded || head.isEmpty())
+    {
+        recent_.removeAll(cacheKey(url));
+        return;
+    }
+
+    emit prefetched(url, head, transferTimer_.elapsed());
+}
+
+void Prefetcher::refillBudget()
+{
+    budget_ = qMin(BUDGET_BURST, budget_ + refillClock_.restart() * BUDGET_REFILL_PER_SECOND / 1000.0);
+}
+
+QString Prefetcher::cacheKey(const QUrl &url)
+{
+    return PlaylistModel::streamKey(url);
+}
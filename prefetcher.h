@@ -0,0 +1,52 @@
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+//! Speculatively fetches the ID3 tag, and with it the cover, of one track
+//! at a time at low priority: the transfer stops once the tag is in or at
+//! the chunk size, a new prefetch cancels the previous one, and a byte
+//! budget that refills slowly bounds what browsing a list can cost
+class Prefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Prefetcher(QNetworkAccessManager *networkManager, QObject *parent = 0);
+
+    void setChunkSize(qint64 chunkSize);
+
+signals:
+    void prefetched(const QUrl& url, const QByteArray& head, qint64 elapsed);
+
+public slots:
+    void prefetch(const QUrl& url);
+    void cancel();
+
+private slots:
+    void readHead();
+    void finishPrefetch();
+
+private:
+    void complete();
+    void refillBudget();
+    static QString cacheKey(const QUrl& url);
+
+    QNetworkAccessManager *networkManager_;
+    QNetworkReply *reply_;
+    QElapsedTimer transferTimer_;
+    QElapsedTimer refillClock_;
+    QStringList recent_;
+    qint64 chunkSize_;
+    //! Bytes wanted from the running prefetch, known once the tag header is in
+    qint64 headSize_;
+    double budget_;
+};
+
+#endif // PREFETCHER_H
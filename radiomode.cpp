@@ -0,0 +1,134 @@
+#include "radiomode.h"
+#include "apicomponent.h"
+#include "mediacomponent.h"
+
+#include <QSettings>
+
+static const int RADIO_LOW_WATER = 10;
+static const int RADIO_BATCH_SIZE = 50;
+static const int RADIO_MAX_EXHAUSTED_BATCHES = 3;
+static const qint64 RADIO_REQUEST_TIMEOUT = 30 * 1000;
+
+RadioMode::RadioMode(ApiComponent *api, MediaComponent *media, QObject *parent) : QObject(parent),
+    api_(api), media_(media), offset_(0), exhaustedBatches_(0), requesting_(false), enabled_(false)
+{
+    Q_ASSERT(api);
+    Q_ASSERT(media);
+
+    connect(media_->playlist(), &QMediaPlaylist::currentIndexChanged, this, &RadioMode::trackStarted);
+    connect(media_->model(), &PlaylistModel::modelReset, this, &RadioMode::forgetRequest);
+    connect(api_, &ApiComponent::recommendationsReceived, this, &RadioMode::appendRecommendations);
+
+    setEnabled(QSettings().value("radio/enabled", false).toBool());
+}
+
+bool RadioMode::isEnabled() const
+{
+    return enabled_;
+}
+
+void RadioMode::setEnabled(bool enabled)
+{
+    enabled_ = enabled;
+    QSettings().setValue("radio/enabled", enabled);
+
+    if (enabled_)
+        extendQueue();
+    else
+        forgetRequest();
+}
+
+void RadioMode::trackStarted(int index)
+{
+    if (media_->isEditingQueue())
+        return;
+
+    PlaylistModel const * const model = media_->model();
+    if (index >= 0 && index < model->rowCount() && !model->track(index).id.isEmpty())
+        played_.insert(model->track(index).id);
+
+    extendQueue();
+}
+
+void RadioMode::forgetRequest()
+{
+    //! A reply seeded by a queue that was replaced is dropped
+    requesting_ = false;
+    seed_.clear();
+    offset_ = 0;
+    exhaustedBatches_ = 0;
+}
+
+void RadioMode::extendQueue()
+{
+    if (!enabled_ || media_->model()->rowCount() == 0 || media_->remainingCount() >= RADIO_LOW_WATER)
+        return;
+
+    if (requesting_ && requestTimer_.elapsed() < RADIO_REQUEST_TIMEOUT)
+        return;
+
+    QString const target = seed();
+    if (target != seed_)
+    {
+        seed_ = target;
+        offset_ = 0;
+        exhaustedBatches_ = 0;
+    }
+
+    requesting_ = true;
+    requestTimer_.start();
+    api_->requestRecommendations(seed_, offset_, RADIO_BATCH_SIZE);
+}
+
+void RadioMode::appendRecommendations(const QString &targetAudio, const PlaylistModel::Tracks &tracks)
+{
+    if (!requesting_ || targetAudio != seed_)
+        return;
+
+    requesting_ = false;
+    offset_ += tracks.size();
+
+    QSet<QString> known = played_;
+    foreach (const PlaylistModel::Track& track, media_->model()->tracks())
+        known.insert(PlaylistModel::trackKey(track));
+
+    PlaylistModel::Tracks fresh;
+    foreach (const PlaylistModel::Track& track, tracks)
+    {
+        QString const key = PlaylistModel::trackKey(track);
+        if (!known.contains(key))
+        {
+            known.insert(key);
+            fresh.append(track);
+        }
+    }
+
+    if (fresh.isEmpty())
+    {
+        //! Page further through the same seed, but not forever; the next
+        //! track change brings a new seed anyway
+        if (!tracks.isEmpty() && ++exhaustedBatches_ < RADIO_MAX_EXHAUSTED_BATCHES)
+            extendQueue();
+        return;
+    }
+
+    exhaustedBatches_ = 0;
+    media_->appendTracks(fresh);
+    extendQueue();
+}
+
+QString RadioMode::seed() const
+{
+    //! The nearest API track at or before the current one; local files
+    //! cannot seed recommendations
+    PlaylistModel const * const model = media_->model();
+    int const current = qMin(media_->playlist()->currentIndex(), model->rowCount() - 1);
+
+    for (int row = current; row >= 0; --row)
+    {
+        if (!model->track(row).id.isEmpty())
+            return model->track(row).id;
+    }
+
+    return QString();
+}
@@ -0,0 +1,48 @@
+#ifndef RADIOMODE_H
+#define RADIOMODE_H
+
+#include "playlistmodel.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QSet>
+
+class ApiComponent;
+class MediaComponent;
+
+//! Endless playback: when few tracks are left ahead in the queue, more
+//! recommendations seeded by the playing track are fetched and appended,
+//! skipping anything already played or queued
+class RadioMode : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RadioMode(ApiComponent *api, MediaComponent *media, QObject *parent = 0);
+
+    bool isEnabled() const;
+
+public slots:
+    void setEnabled(bool enabled);
+
+private slots:
+    void trackStarted(int index);
+    void forgetRequest();
+    void extendQueue();
+    void appendRecommendations(const QString& targetAudio, const PlaylistModel::Tracks& tracks);
+
+private:
+    QString seed() const;
+
+    ApiComponent *api_;
+    MediaComponent *media_;
+    QSet<QString> played_;
+    QString seed_;
+    int offset_;
+    int exhaustedBatches_;
+    bool requesting_;
+    QElapsedTimer requestTimer_;
+    bool enabled_;
+};
+
+#endif // RADIOMODE_H
@@ -0,0 +1,88 @@
+#include "resourcemonitor.h"
+
+#include <QAtomicInteger>
+#include <QNetworkReply>
+#include <QPixmap>
+#include <QStringList>
+
+static QAtomicInteger<qint64> resourceCounts[ResourceMonitor::ResourceCount];
+static QAtomicInteger<qint64> resourceBytes[ResourceMonitor::ResourceCount];
+
+void ResourceMonitor::track(QObject *object, ResourceMonitor::Resource resource, qint64 bytes)
+{
+    Q_ASSERT(object);
+
+    adjust(resource, 1, bytes);
+    QObject::connect(object, &QObject::destroyed, [resource, bytes]()
+    {
+        adjust(resource, -1, -bytes);
+    });
+}
+
+void ResourceMonitor::adjust(ResourceMonitor::Resource resource, qint64 count, qint64 bytes)
+{
+    resourceCounts[resource].fetchAndAddRelaxed(count);
+    resourceBytes[resource].fetchAndAddRelaxed(bytes);
+}
+
+qint64 ResourceMonitor::pixmapBytes(const QPixmap &pixmap)
+{
+    return pixmap.isNull() ? 0 : qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+}
+
+ResourceMonitor::Snapshot ResourceMonitor::snapshot()
+{
+    Snapshot snapshot;
+    for (int i = 0; i < ResourceCount; ++i)
+    {
+        snapshot.count[i] = resourceCounts[i].load();
+        snapshot.bytes[i] = resourceBytes[i].load();
+    }
+
+    return snapshot;
+}
+
+QString ResourceMonitor::name(ResourceMonitor::Resource resource)
+{
+    switch (resource) {
+    case NetworkManagers:
+        return "Network managers";
+    case NetworkReplies:
+        return "Network replies";
+    case Images:
+        return "Images";
+    case ModelRows:
+        return "Model rows";
+    default:
+        return QString();
+    }
+}
+
+QString ResourceMonitor::report()
+{
+    Snapshot const current = snapshot();
+    QStringList lines;
+
+    for (int i = 0; i < ResourceCount; ++i)
+    {
+        QString line = name(Resource(i)) + ": " + QString::number(current.count[i]);
+        if (current.bytes[i] != 0)
+            line += " (" + QString::number(current.bytes[i]) + " bytes)";
+        lines.append(line);
+    }
+
+    return lines.join('\n');
+}
+
+MonitoredNetworkAccessManager::MonitoredNetworkAccessManager(QObject *parent) : QNetworkAccessManager(parent)
+{
+    ResourceMonitor::track(this, ResourceMonitor::NetworkManagers);
+}
+
+QNetworkReply *MonitoredNetworkAccessManager::createRequest(QNetworkAccessManager::Operation operation,
+                                                            const QNetworkRequest &request, QIODevice *outgoingData)
+{
+    QNetworkReply *reply = QNetworkAccessManager::createRequest(operation, request, outgoingData);
+    ResourceMonitor::track(reply, ResourceMonitor::NetworkReplies);
+    return reply;
+}
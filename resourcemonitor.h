@@ -0,0 +1,51 @@
+#ifndef RESOURCEMONITOR_H
+#define RESOURCEMONITOR_H
+
+#include <QNetworkAccessManager>
+#include <QString>
+
+class QPixmap;
+
+//! Process-wide counters of live resources that tend to pile up in long
+//! tray sessions; cheap enough to stay enabled in release builds
+class ResourceMonitor
+{
+public:
+    enum Resource
+    {
+        NetworkManagers,
+        NetworkReplies,
+        Images,
+        ModelRows,
+        ResourceCount
+    };
+
+    struct Snapshot
+    {
+        qint64 count[ResourceCount];
+        qint64 bytes[ResourceCount];
+    };
+
+    static void track(QObject *object, Resource resource, qint64 bytes = 0);
+    static void adjust(Resource resource, qint64 count, qint64 bytes = 0);
+
+    static qint64 pixmapBytes(const QPixmap& pixmap);
+
+    static Snapshot snapshot();
+    static QString name(Resource resource);
+    static QString report();
+};
+
+//! Network manager whose own lifetime and every reply it creates are counted
+class MonitoredNetworkAccessManager : public QNetworkAccessManager
+{
+    Q_OBJECT
+
+public:
+    explicit MonitoredNetworkAccessManager(QObject *parent = 0);
+
+protected:
+    QNetworkReply * createRequest(Operation operation, const QNetworkRequest& request, QIODevice *outgoingData = 0);
+};
+
+#endif // RESOURCEMONITOR_H
@@ -0,0 +1,96 @@
+#include "resourcepanel.h"
+#include "apirequestscheduler.h"
+
+#include <QGridLayout>
+#include <QLabel>
+#include <QTimer>
+
+static const int RESOURCE_PANEL_REFRESH_INTERVAL = 500;
+
+ResourcePanel::ResourcePanel(ApiRequestScheduler *scheduler, QWidget *parent) : QWidget(parent),
+    queueDepthLabel_(new QLabel(this)), waitLabel_(new QLabel(this)), throttledLabel_(new QLabel(this)),
+    refreshTimer_(new QTimer(this)), throttled_(0)
+{
+    Q_ASSERT(scheduler);
+
+    setWindowTitle("Flow Resources");
+    setWindowFlags(Qt::Tool);
+    setWindowIcon(QIcon(":icons/logo.png"));
+
+    QGridLayout *layout = new QGridLayout(this);
+    for (int i = 0; i < ResourceMonitor::ResourceCount; ++i)
+    {
+        countLabels_[i] = new QLabel(this);
+        bytesLabels_[i] = new QLabel(this);
+        countLabels_[i]->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        bytesLabels_[i]->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+
+        layout->addWidget(new QLabel(ResourceMonitor::name(ResourceMonitor::Resource(i)), this), i, 0);
+        layout->addWidget(countLabels_[i], i, 1);
+        layout->addWidget(bytesLabels_[i], i, 2);
+    }
+
+    //! Rate limiting shows up here as a growing queue, long waits and retries
+    int const row = ResourceMonitor::ResourceCount;
+    QLabel * const labels[] = { queueDepthLabel_, waitLabel_, throttledLabel_ };
+    const char * const names[] = { "API queue", "API wait", "API rate limited" };
+    for (int i = 0; i < int(sizeof(labels) / sizeof(labels[0])); ++i)
+    {
+        labels[i]->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        layout->addWidget(new QLabel(names[i], this), row + i, 0);
+        layout->addWidget(labels[i], row + i, 1);
+    }
+
+    showQueueDepth(scheduler->queueDepth());
+    showDispatch(QUrl(), scheduler->lastWaitTime());
+    throttledLabel_->setText("0");
+
+    connect(scheduler, &ApiRequestScheduler::queueDepthChanged, this, &ResourcePanel::showQueueDepth);
+    connect(scheduler, &ApiRequestScheduler::requestDispatched, this, &ResourcePanel::showDispatch);
+    connect(scheduler, &ApiRequestScheduler::requestThrottled, this, &ResourcePanel::showThrottle);
+
+    refreshTimer_->setInterval(RESOURCE_PANEL_REFRESH_INTERVAL);
+    connect(refreshTimer_, &QTimer::timeout, this, &ResourcePanel::refresh);
+}
+
+void ResourcePanel::showEvent(QShowEvent *event)
+{
+    refresh();
+    refreshTimer_->start();
+    QWidget::showEvent(event);
+}
+
+void ResourcePanel::hideEvent(QHideEvent *event)
+{
+    refreshTimer_->stop();
+    QWidget::hideEvent(event);
+}
+
+void ResourcePanel::refresh()
+{
+    ResourceMonitor::Snapshot const snapshot = ResourceMonitor::snapshot();
+
+    for (int i = 0; i < ResourceMonitor::ResourceCount; ++i)
+    {
+        countLabels_[i]->setText(QString::number(snapshot.count[i]));
+        bytesLabels_[i]->setText(snapshot.bytes[i] != 0 ? QString::number(snapshot.bytes[i] / 1024) + " KB" : QString());
+    }
+}
+
+void ResourcePanel::showQueueDepth(int depth)
+{
+    queueDepthLabel_->setText(QString::number(depth));
+}
+
+void ResourcePanel::showDispatch(const QUrl &url, qint64 waitTime)
+{
+    waitLabel_->setText(QString::number(waitTime) + " ms");
+    waitLabel_->setToolTip(url.path());
+}
+
+void ResourcePanel::showThrottle(const QUrl &url, int attempt, int delay)
+{
+    ++throttled_;
+    throttledLabel_->setText(QString::number(throttled_));
+    throttledLabel_->setToolTip(QString("%1, attempt %2, retry in %3 ms").arg(url.path()).arg(attempt).arg(delay));
+}
@@ -0,0 +1,41 @@
+#ifndef RESOURCEPANEL_H
+#define RESOURCEPANEL_H
+
+#include "resourcemonitor.h"
+
+#include <QWidget>
+
+class ApiRequestScheduler;
+class QLabel;
+class QTimer;
+
+//! Debug window with the live ResourceMonitor counters and the state of the
+//! API request queue; rate-limit retries are counted from its creation
+class ResourcePanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ResourcePanel(ApiRequestScheduler *scheduler, QWidget *parent = 0);
+
+protected:
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+
+private slots:
+    void refresh();
+    void showQueueDepth(int depth);
+    void showDispatch(const QUrl& url, qint64 waitTime);
+    void showThrottle(const QUrl& url, int attempt, int delay);
+
+private:
+    QLabel *countLabels_[ResourceMonitor::ResourceCount];
+    QLabel *bytesLabels_[ResourceMonitor::ResourceCount];
+    QLabel *queueDepthLabel_;
+    QLabel *waitLabel_;
+    QLabel *throttledLabel_;
+    QTimer *refreshTimer_;
+    int throttled_;
+};
+
+#endif // RESOURCEPANEL_H
@@ -0,0 +1,267 @@
+#include "shuffleorder.h"
+
+//! Where index ends up once the rows [first, first + count) are moved in
+//! front of destination
+static int movedIndex(int index, int first, int count, int destination)
+{
+    int const last = first + count;
+
+    if (destination > last)
+    {
+        if (index >= first && index < last)
+            return index + destination - last;
+        if (index >= last && index < destination)
+            return index - count;
+    }
+    else if (destination < first)
+    {
+        if (index >= first && index < last)
+            return index - (first - destination);
+        if (index >= destination && index < first)
+            return index + count;
+    }
+
+    return index;
+}
+
+ShuffleOrder::ShuffleOrder(quint32 seed) : random_(seed), cursor_(-1)
+{
+}
+
+void ShuffleOrder::reset(int count, int current)
+{
+    order_.resize(count);
+    for (int i = 0; i < count; ++i)
+        order_[i] = i;
+
+    generate(order_, -1);
+
+    position_.resize(count);
+    for (int i = 0; i < count; ++i)
+        position_[order_.at(i)] = i;
+
+    //! Without a playing track the cursor stays in front of the cycle so
+    //! next() starts at its first index instead of skipping it
+    cursor_ = -1;
+    if (current >= 0 && current < count)
+    {
+        //! Keep the playing track first so the rest of the cycle is still ahead
+        int const position = position_.at(current);
+        qSwap(order_[0], order_[position]);
+        position_[order_.at(0)] = 0;
+        position_[order_.at(position)] = position;
+        cursor_ = 0;
+    }
+
+    nextOrder_ = order_;
+    generate(nextOrder_, order_.isEmpty() ? -1 : order_.last());
+}
+
+void ShuffleOrder::append(int count)
+{
+    insert(order_.size(), count, false);
+}
+
+void ShuffleOrder::insert(int first, int count, bool next)
+{
+    for (int i = 0; i < order_.size(); ++i)
+    {
+        if (order_.at(i) >= first)
+            order_[i] += count;
+    }
+
+    for (int i = 0; i < nextOrder_.size(); ++i)
+    {
+        if (nextOrder_.at(i) >= first)
+            nextOrder_[i] += count;
+    }
+
+    //! New indexes either play right after the current one, in queue order,
+    //! or join the rest of this cycle at random places; what was played and
+    //! the order ahead stay as they are
+    for (int index = first; index < first + count; ++index)
+    {
+        if (next)
+            order_.insert(cursor_ + 1 + index - first, index);
+        else
+        {
+            std::uniform_int_distribution<int> place(cursor_ + 1, order_.size());
+            order_.insert(place(random_), index);
+        }
+
+        std::uniform_int_distribution<int> nextPlace(0, nextOrder_.size());
+        nextOrder_.insert(nextPlace(random_), index);
+    }
+
+    updatePositions();
+    separateCycles();
+}
+
+void ShuffleOrder::remove(int first, int count)
+{
+    int const last = first + count;
+
+    for (int i = order_.size() - 1; i >= 0; --i)
+    {
+        int const index = order_.at(i);
+        if (index >= first && index < last)
+        {
+            order_.remove(i);
+            if (i <= cursor_)
+                --cursor_;
+        }
+        else if (index >= last)
+            order_[i] -= count;
+    }
+
+    for (int i = nextOrder_.size() - 1; i >= 0; --i)
+    {
+        int const index = nextOrder_.at(i);
+        if (index >= first && index < last)
+            nextOrder_.remove(i);
+        else if (index >= last)
+            nextOrder_[i] -= count;
+    }
+
+    updatePositions();
+    separateCycles();
+}
+
+void ShuffleOrder::move(int first, int count, int destination)
+{
+    //! The tracks keep their turn, only the indexes they are found at change
+    for (int i = 0; i < order_.size(); ++i)
+        order_[i] = movedIndex(order_.at(i), first, count, destination);
+
+    for (int i = 0; i < nextOrder_.size(); ++i)
+        nextOrder_[i] = movedIndex(nextOrder_.at(i), first, count, destination);
+
+    updatePositions();
+}
+
+int ShuffleOrder::count() const
+{
+    return order_.size();
+}
+
+int ShuffleOrder::current() const
+{
+    return cursor_ >= 0 ? order_.at(cursor_) : -1;
+}
+
+int ShuffleOrder::remaining() const
+{
+    return order_.size() - 1 - cursor_;
+}
+
+bool ShuffleOrder::atEnd() const
+{
+    return cursor_ == order_.size() - 1;
+}
+
+int ShuffleOrder::next()
+{
+    if (order_.isEmpty())
+        return -1;
+
+    if (atEnd())
+        advanceCycle();
+    else
+        ++cursor_;
+
+    return current();
+}
+
+int ShuffleOrder::previous()
+{
+    if (cursor_ > 0)
+        --cursor_;
+
+    return current();
+}
+
+void ShuffleOrder::moveTo(int index)
+{
+    if (index < 0 || index >= order_.size())
+        return;
+
+    int const position = position_.at(index);
+    if (position == cursor_)
+        return;
+
+    if (position < cursor_)
+    {
+        //! Replaying a track takes it out of the played part and puts it at
+        //! the cursor; the tracks after it keep their turn in this cycle
+        order_.remove(position);
+        order_.insert(cursor_, index);
+        updatePositions();
+        return;
+    }
+
+    //! Bring the chosen track right after the current one, leaving the
+    //! remaining shuffled tracks ahead of the cursor untouched
+    int const target = cursor_ + 1;
+    qSwap(order_[target], order_[position]);
+    position_[order_.at(target)] = target;
+    position_[order_.at(position)] = position;
+    cursor_ = target;
+}
+
+QVector<int> ShuffleOrder::upcoming(int count) const
+{
+    QVector<int> indexes;
+    indexes.reserve(count);
+
+    for (int i = cursor_ + 1; i < order_.size() && indexes.size() < count; ++i)
+        indexes.append(order_.at(i));
+
+    for (int i = 0; i < nextOrder_.size() && indexes.size() < count; ++i)
+        indexes.append(nextOrder_.at(i));
+
+    return indexes;
+}
+
+void ShuffleOrder::generate(QVector<int> &order, int avoidFirst)
+{
+    int const count = order.size();
+    for (int i = count - 1; i > 0; --i)
+    {
+        std::uniform_int_distribution<int> distribution(0, i);
+        qSwap(order[i], order[distribution(random_)]);
+    }
+
+    //! Never repeat a track across the boundary between two cycles
+    if (count > 1 && order.at(0) == avoidFirst)
+    {
+        std::uniform_int_distribution<int> distribution(1, count - 1);
+        qSwap(order[0], order[distribution(random_)]);
+    }
+}
+
+void ShuffleOrder::advanceCycle()
+{
+    order_.swap(nextOrder_);
+
+    for (int i = 0; i < order_.size(); ++i)
+        position_[order_.at(i)] = i;
+
+    generate(nextOrder_, order_.last());
+    cursor_ = 0;
+}
+
+void ShuffleOrder::updatePositions()
+{
+    position_.resize(order_.size());
+    for (int i = 0; i < order_.size(); ++i)
+        position_[order_.at(i)] = i;
+}
+
+void ShuffleOrder::separateCycles()
+{
+    if (!order_.isEmpty() && nextOrder_.size() > 1 && nextOrder_.at(0) == order_.last())
+    {
+        std::uniform_int_distribution<int> distribution(1, nextOrder_.size() - 1);
+        qSwap(nextOrder_[0], nextOrder_[distribution(random_)]);
+    }
+}
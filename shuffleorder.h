@@ -0,0 +1,47 @@
+#ifndef SHUFFLEORDER_H
+#define SHUFFLEORDER_H
+
+#include <QVector>
+
+#include <random>
+
+//! Fisher-Yates permutation of a queue, generated once per cycle.
+//! The cycle after the current one is generated up front, so the upcoming
+//! indexes are always known even across a re-shuffle.
+class ShuffleOrder
+{
+public:
+    explicit ShuffleOrder(quint32 seed = std::random_device()());
+
+    void reset(int count, int current = -1);
+    void append(int count);
+    //! Edits of the queue map onto the order without a re-shuffle
+    void insert(int first, int count, bool next);
+    void remove(int first, int count);
+    void move(int first, int count, int destination);
+
+    int count() const;
+    int current() const;
+    int remaining() const;
+    bool atEnd() const;
+
+    int next();
+    int previous();
+    void moveTo(int index);
+
+    QVector<int> upcoming(int count) const;
+
+private:
+    void generate(QVector<int>& order, int avoidFirst);
+    void advanceCycle();
+    void updatePositions();
+    void separateCycles();
+
+    std::mt19937 random_;
+    QVector<int> order_;
+    QVector<int> nextOrder_;
+    QVector<int> position_;
+    int cursor_;
+};
+
+#endif // SHUFFLEORDER_H
@@ -0,0 +1,342 @@
+#include "spectrumanalyzer.h"
+
+#include <QAudioProbe>
+#include <QGuiApplication>
+#include <QMediaPlayer>
+#include <QScreen>
+#include <QTimer>
+#include <QtMath>
+
+#include <cmath>
+#include <cstring>
+
+static const int TAP_CAPACITY = 64;
+static const int FFT_BITS = 11;
+static const int FFT_SIZE = 1 << FFT_BITS;
+static const float MIN_FREQUENCY = 40.0f;
+static const float MAX_FREQUENCY = 16000.0f;
+static const float LEVEL_FLOOR = -70.0f;
+static const float BAR_DECAY = 0.85f;
+static const float SILENT_LEVEL = 0.001f;
+static const qreal DEFAULT_REFRESH_RATE = 60.0;
+
+SpectrumTap::SpectrumTap(int capacity) : ring_(capacity), mask_(capacity - 1), head_(0), tail_(0)
+{
+    Q_ASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0);
+}
+
+void SpectrumTap::push(const QAudioBuffer &buffer)
+{
+    quint32 const head = head_.load();
+    quint32 const tail = tail_.loadAcquire();
+    if (head - tail > mask_)
+        return;
+
+    ring_.data()[head & mask_] = buffer;
+    head_.storeRelease(head + 1);
+}
+
+bool SpectrumTap::pop(QAudioBuffer &buffer)
+{
+    quint32 const tail = tail_.load();
+    quint32 const head = head_.loadAcquire();
+    if (tail == head)
+        return false;
+
+    //! Release the slot's reference here, so the producer never frees data
+    QAudioBuffer &slot = ring_.data()[tail & mask_];
+    buffer = slot;
+    slot = QAudioBuffer();
+
+    tail_.storeRelease(tail + 1);
+    return true;
+}
+
+void SpectrumTap::clear()
+{
+    //! Consumer side: drop everything the producer has published so far
+    QAudioBuffer buffer;
+    while (pop(buffer))
+        ;
+}
+
+SpectrumWorker::SpectrumWorker(SpectrumTap *tap, int barCount, QObject *parent) : QObject(parent),
+    tap_(tap), timer_(0), history_(FFT_SIZE, 0.0f), window_(FFT_SIZE), real_(FFT_SIZE), imaginary_(FFT_SIZE),
+    cosines_(FFT_SIZE / 2), sines_(FFT_SIZE / 2), reversed_(FFT_SIZE), bars_(barCount, 0.0f),
+    sampleRate_(0), silent_(true)
+{
+    Q_ASSERT(tap);
+
+    for (int i = 0; i < FFT_SIZE; ++i)
+    {
+        window_[i] = 0.5f - 0.5f * qCos(2.0 * M_PI * i / (FFT_SIZE - 1));
+
+        int reversed = 0;
+        for (int bit = 0; bit < FFT_BITS; ++bit)
+            reversed |= ((i >> bit) & 1) << (FFT_BITS - 1 - bit);
+        reversed_[i] = reversed;
+    }
+
+    for (int i = 0; i < FFT_SIZE / 2; ++i)
+    {
+        cosines_[i] = qCos(2.0 * M_PI * i / FFT_SIZE);
+        sines_[i] = -qSin(2.0 * M_PI * i / FFT_SIZE);
+    }
+}
+
+void SpectrumWorker::start(int interval)
+{
+    if (!timer_)
+    {
+        timer_ = new QTimer(this);
+        timer_->setTimerType(Qt::PreciseTimer);
+        connect(timer_, &QTimer::timeout, this, &SpectrumWorker::analyze);
+    }
+
+    tap_->clear();
+    history_.fill(0.0f);
+    timer_->start(interval);
+}
+
+void SpectrumWorker::stop()
+{
+    if (timer_)
+        timer_->stop();
+
+    tap_->clear();
+    bars_.fill(0.0f);
+    silent_ = true;
+    emit barsUpdated(bars_);
+}
+
+void SpectrumWorker::analyze()
+{
+    //! Keep the newest FFT_SIZE samples
+    float * const history = history_.data();
+    bool fresh = false;
+    QAudioBuffer buffer;
+
+    while (tap_->pop(buffer))
+    {
+        int const frames = qMin(downmix(buffer), FFT_SIZE);
+        if (frames <= 0)
+            continue;
+
+        const float * const mono = mono_.constData() + mono_.size() - frames;
+        std::memmove(history, history + frames, (FFT_SIZE - frames) * sizeof(float));
+        std::memcpy(history + FFT_SIZE - frames, mono, frames * sizeof(float));
+        sampleRate_ = buffer.format().sampleRate();
+        fresh = true;
+    }
+
+    if (fresh && sampleRate_ > 0)
+    {
+        transform();
+
+        int const barCount = bars_.size();
+        float const binWidth = float(sampleRate_) / FFT_SIZE;
+        float const ratio = MAX_FREQUENCY / MIN_FREQUENCY;
+
+        for (int bar = 0; bar < barCount; ++bar)
+        {
+            float const low = MIN_FREQUENCY * qPow(ratio, float(bar) / barCount);
+            float const high = MIN_FREQUENCY * qPow(ratio, float(bar + 1) / barCount);
+            int const first = qBound(1, int(low / binWidth), FFT_SIZE / 2 - 1);
+            int const last = qBound(first + 1, int(high / binWidth), FFT_SIZE / 2);
+
+            float peak = 0.0f;
+            for (int bin = first; bin < last; ++bin)
+                peak = qMax(peak, real_.at(bin) * real_.at(bin) + imaginary_.at(bin) * imaginary_.at(bin));
+
+            //! Hann window and one-sided spectrum: amplitude is 4 |X| / N
+            float const amplitude = 4.0f * qSqrt(peak) / FFT_SIZE;
+            float const decibels = amplitude > 0.0f ? 20.0f * std::log10(amplitude) : LEVEL_FLOOR;
+            float const level = qBound(0.0f, (decibels - LEVEL_FLOOR) / -LEVEL_FLOOR, 1.0f);
+
+            bars_[bar] = qMax(level, bars_.at(bar) * BAR_DECAY);
+        }
+
+        silent_ = false;
+        emit barsUpdated(bars_);
+        return;
+    }
+
+    //! Paused or between tracks: let the bars fall, then go quiet
+    if (silent_)
+        return;
+
+    bool silent = true;
+    for (int bar = 0; bar < bars_.size(); ++bar)
+    {
+        bars_[bar] *= BAR_DECAY;
+        if (bars_.at(bar) > SILENT_LEVEL)
+            silent = false;
+        else
+            bars_[bar] = 0.0f;
+    }
+
+    silent_ = silent;
+    emit barsUpdated(bars_);
+}
+
+//! Converts buffer to mono samples in mono_, resized to its frame count;
+//! returns 0 for formats the probe does not produce in practice
+int SpectrumWorker::downmix(const QAudioBuffer &buffer)
+{
+    QAudioFormat const format = buffer.format();
+    int const channels = format.channelCount();
+    int const frames = buffer.frameCount();
+    if (channels <= 0 || frames <= 0)
+        return 0;
+
+    mono_.resize(frames);
+
+    float * const mono = mono_.data();
+    float const scale = 1.0f / channels;
+
+    if (format.sampleType() == QAudioFormat::Float && format.sampleSize() == 32)
+    {
+        const float *samples = buffer.constData<float>();
+        for (int frame = 0; frame < frames; ++frame, samples += channels)
+        {
+            float sum = 0.0f;
+            for (int channel = 0; channel < channels; ++channel)
+                sum += samples[channel];
+            mono[frame] = sum * scale;
+        }
+    }
+    else if (format.sampleType() == QAudioFormat::SignedInt && format.sampleSize() == 16)
+    {
+        const qint16 *samples = buffer.constData<qint16>();
+        for (int frame = 0; frame < frames; ++frame, samples += channels)
+        {
+            int sum = 0;
+            for (int channel = 0; channel < channels; ++channel)
+                sum += samples[channel];
+            mono[frame] = sum * scale / 32768.0f;
+        }
+    }
+    else if (format.sampleType() == QAudioFormat::SignedInt && format.sampleSize() == 32)
+    {
+        const qint32 *samples = buffer.constData<qint32>();
+        for (int frame = 0; frame < frames; ++frame, samples += channels)
+        {
+            float sum = 0.0f;
+            for (int channel = 0; channel < channels; ++channel)
+                sum += samples[channel] / 2147483648.0f;
+            mono[frame] = sum * scale;
+        }
+    }
+    else if (format.sampleType() == QAudioFormat::UnSignedInt && format.sampleSize() == 8)
+    {
+        const quint8 *samples = buffer.constData<quint8>();
+        for (int frame = 0; frame < frames; ++frame, samples += channels)
+        {
+            int sum = 0;
+            for (int channel = 0; channel < channels; ++channel)
+                sum += samples[channel] - 128;
+            mono[frame] = sum * scale / 128.0f;
+        }
+    }
+    else
+        return 0;
+
+    return frames;
+}
+
+void SpectrumWorker::transform()
+{
+    float * const real = real_.data();
+    float * const imaginary = imaginary_.data();
+
+    for (int i = 0; i < FFT_SIZE; ++i)
+    {
+        real[reversed_.at(i)] = history_.at(i) * window_.at(i);
+        imaginary[i] = 0.0f;
+    }
+
+    for (int size = 2; size <= FFT_SIZE; size <<= 1)
+    {
+        int const half = size / 2;
+        int const step = FFT_SIZE / size;
+
+        for (int start = 0; start < FFT_SIZE; start += size)
+        {
+            for (int k = 0; k < half; ++k)
+            {
+                float const wr = cosines_.at(k * step);
+                float const wi = sines_.at(k * step);
+                int const even = start + k;
+                int const odd = even + half;
+
+                float const tr = wr * real[odd] - wi * imaginary[odd];
+                float const ti = wr * imaginary[odd] + wi * real[odd];
+
+                real[odd] = real[even] - tr;
+                imaginary[odd] = imaginary[even] - ti;
+                real[even] += tr;
+                imaginary[even] += ti;
+            }
+        }
+    }
+}
+
+SpectrumAnalyzer::SpectrumAnalyzer(QMediaPlayer *player, QObject *parent) : QObject(parent),
+    player_(player), probe_(0), tap_(TAP_CAPACITY), worker_(new SpectrumWorker(&tap_, BAR_COUNT))
+{
+    Q_ASSERT(player);
+
+    qRegisterMetaType<QVector<float> >("QVector<float>");
+
+    worker_->moveToThread(&thread_);
+    connect(worker_, &SpectrumWorker::barsUpdated, this, &SpectrumAnalyzer::barsUpdated);
+    thread_.start(QThread::LowPriority);
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer()
+{
+    thread_.quit();
+    thread_.wait();
+    delete worker_;
+}
+
+bool SpectrumAnalyzer::isActive() const
+{
+    return probe_ != 0;
+}
+
+void SpectrumAnalyzer::setActive(bool active)
+{
+    if (active == isActive())
+        return;
+
+    if (active)
+    {
+        probe_ = new QAudioProbe(this);
+        if (!probe_->setSource(player_))
+        {
+            delete probe_;
+            probe_ = 0;
+            return;
+        }
+
+        connect(probe_, &QAudioProbe::audioBufferProbed, this, &SpectrumAnalyzer::tapBuffer);
+
+        QScreen * const screen = QGuiApplication::primaryScreen();
+        qreal const refreshRate = screen && screen->refreshRate() > 0 ? screen->refreshRate() : DEFAULT_REFRESH_RATE;
+        QMetaObject::invokeMethod(worker_, "start", Qt::QueuedConnection, Q_ARG(int, qRound(1000.0 / refreshRate)));
+    }
+    else
+    {
+        delete probe_;
+        probe_ = 0;
+        QMetaObject::invokeMethod(worker_, "stop", Qt::QueuedConnection);
+    }
+}
+
+void SpectrumAnalyzer::tapBuffer(const QAudioBuffer &buffer)
+{
+    //! The probe delivers on the GUI thread; hand the buffer over as is and
+    //! leave the conversion to the worker
+    tap_.push(buffer);
+}
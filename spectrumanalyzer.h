@@ -0,0 +1,103 @@
+#ifndef SPECTRUMANALYZER_H
+#define SPECTRUMANALYZER_H
+
+#include <QAtomicInteger>
+#include <QAudioBuffer>
+#include <QObject>
+#include <QThread>
+#include <QVector>
+
+class QAudioProbe;
+class QMediaPlayer;
+class QTimer;
+
+//! Single producer, single consumer ring of probed buffers; neither side
+//! locks and the producer drops what does not fit. The buffers are shared,
+//! so pushing one only takes a reference to its data.
+class SpectrumTap
+{
+public:
+    explicit SpectrumTap(int capacity);
+
+    void push(const QAudioBuffer& buffer);
+    bool pop(QAudioBuffer& buffer);
+    void clear();
+
+private:
+    QVector<QAudioBuffer> ring_;
+    quint32 const mask_;
+    QAtomicInteger<quint32> head_;
+    QAtomicInteger<quint32> tail_;
+};
+
+//! Runs on the analyzer thread: downmixes the tapped buffers, windows the
+//! newest samples, transforms them and reduces the spectrum to log-spaced
+//! bars once per display frame
+class SpectrumWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SpectrumWorker(SpectrumTap *tap, int barCount, QObject *parent = 0);
+
+signals:
+    void barsUpdated(const QVector<float>& bars);
+
+public slots:
+    void start(int interval);
+    void stop();
+
+private slots:
+    void analyze();
+
+private:
+    int downmix(const QAudioBuffer& buffer);
+    void transform();
+
+    SpectrumTap *tap_;
+    QTimer *timer_;
+    QVector<float> history_;
+    QVector<float> window_;
+    QVector<float> real_;
+    QVector<float> imaginary_;
+    QVector<float> cosines_;
+    QVector<float> sines_;
+    QVector<int> reversed_;
+    QVector<float> bars_;
+    QVector<float> mono_;
+    int sampleRate_;
+    bool silent_;
+};
+
+//! Spectrum of what the player outputs, fed by a QAudioProbe. Inactive
+//! analyzers hold no probe and leave their thread idle.
+class SpectrumAnalyzer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SpectrumAnalyzer(QMediaPlayer *player, QObject *parent = 0);
+    ~SpectrumAnalyzer();
+
+    static const int BAR_COUNT = 32;
+
+    bool isActive() const;
+
+signals:
+    void barsUpdated(const QVector<float>& bars);
+
+public slots:
+    void setActive(bool active);
+
+private slots:
+    void tapBuffer(const QAudioBuffer& buffer);
+
+private:
+    QMediaPlayer *player_;
+    QAudioProbe *probe_;
+    SpectrumTap tap_;
+    QThread thread_;
+    SpectrumWorker *worker_;
+};
+
+#endif // SPECTRUMANALYZER_H
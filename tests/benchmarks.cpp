@@ -0,0 +1,265 @@
+#include "benchmarks.h"
+#include "coverartscanner.h"
+#include "equalizer.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryFile>
+
+#include <taglib/attachedpictureframe.h>
+#include <taglib/id3v2tag.h>
+#include <taglib/mpegfile.h>
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static const int EQUALIZER_BENCHMARK_SECONDS = 600;
+static const int EQUALIZER_BENCHMARK_BLOCK = 1024;
+static const int EQUALIZER_BENCHMARK_RATE = 44100;
+static const int COVER_ART_BENCHMARK_ROUNDS = 200;
+static const int COVER_ART_FUZZ_MAX_MUTATIONS = 8;
+
+int benchmarkEqualizer()
+{
+    Equalizer equalizer;
+    equalizer.setSampleRate(EQUALIZER_BENCHMARK_RATE);
+    equalizer.setGains(Equalizer::presetGains("Rock"));
+
+    std::vector<float> source(EQUALIZER_BENCHMARK_BLOCK * 2);
+    for (size_t i = 0; i < source.size(); ++i)
+        source[i] = float((i * 7919) % 2001) / 1000.0f - 1.0f;
+    std::vector<float> block(source.size());
+
+    qint64 const frames = qint64(EQUALIZER_BENCHMARK_SECONDS) * EQUALIZER_BENCHMARK_RATE;
+    QElapsedTimer timer;
+    timer.start();
+
+    for (qint64 frame = 0; frame < frames; frame += EQUALIZER_BENCHMARK_BLOCK)
+    {
+        block = source;
+        equalizer.process(block.data(), EQUALIZER_BENCHMARK_BLOCK, 2);
+    }
+
+    double const perSecond = double(timer.nsecsElapsed()) / EQUALIZER_BENCHMARK_SECONDS / 1000.0;
+
+#ifdef __SSE2__
+    const char * const path = "SSE2";
+#else
+    const char * const path = "scalar";
+#endif
+
+    std::printf("equalizer: %.1f us per second of stereo audio (%s, %d bands, checksum %g)\n",
+                perSecond, path, int(Equalizer::BandCount), double(block[0]));
+
+    return 0;
+}
+
+static QByteArray bigEndian(quint32 value, int bytes)
+{
+    QByteArray encoded;
+    for (int i = bytes - 1; i >= 0; --i)
+        encoded.append(char(value >> (8 * i)));
+    return encoded;
+}
+
+static QByteArray syncSafe(quint32 value)
+{
+    QByteArray encoded;
+    for (int i = 3; i >= 0; --i)
+        encoded.append(char((value >> (7 * i)) & 0x7f));
+    return encoded;
+}
+
+static QByteArray unsynchronise(const QByteArray& data)
+{
+    QByteArray encoded;
+    for (int i = 0; i < data.size(); ++i)
+    {
+        encoded.append(data.at(i));
+        if (quint8(data.at(i)) == 0xff && (i + 1 == data.size() || quint8(data.at(i + 1)) >= 0xe0 || data.at(i + 1) == 0))
+            encoded.append('\0');
+    }
+    return encoded;
+}
+
+static QByteArray atom(const char *type, const QByteArray& payload)
+{
+    return bigEndian(payload.size() + 8, 4) + type + payload;
+}
+
+//! One well-formed file per supported layout, each carrying the same image
+static QList<QByteArray> coverArtSamples(const QByteArray& image)
+{
+    QByteArray const apic = QByteArray(1, '\0') + "image/jpeg" + QByteArray(1, '\0') + char(3) + "Cover" +
+            QByteArray(1, '\0') + image;
+    QByteArray const title = QByteArray(1, '\0') + "Title";
+    QList<QByteArray> samples;
+
+    //! 2.3, plain and with whole-tag unsynchronisation, extended header, a
+    //! back cover before the front one and padding
+    for (int unsynchronised = 0; unsynchronised < 2; ++unsynchronised)
+    {
+        QByteArray body = bigEndian(6, 4) + QByteArray(6, '\0');
+        body += "TIT2" + bigEndian(title.size(), 4) + QByteArray(2, '\0') + title;
+        QByteArray backCover = apic;
+        backCover[12] = 4;
+        body += "APIC" + bigEndian(backCover.size(), 4) + QByteArray(2, '\0') + backCover;
+        body += "APIC" + bigEndian(apic.size(), 4) + QByteArray(2, '\0') + apic;
+        body += QByteArray(32, '\0');
+        if (unsynchronised)
+            body = unsynchronise(body);
+        samples.append("ID3" + QByteArray(1, 3) + QByteArray(1, '\0') + char(0x40 | (unsynchronised ? 0x80 : 0)) +
+                       syncSafe(body.size()) + body + "audio");
+    }
+
+    //! 2.4 with an extended header and an unsynchronised frame carrying a
+    //! data length indicator
+    QByteArray const frame = syncSafe(apic.size()) + unsynchronise(apic);
+    QByteArray const body = syncSafe(6) + QByteArray(1, 1) + QByteArray(1, '\0') +
+            "APIC" + syncSafe(frame.size()) + QByteArray(1, '\0') + char(0x03) + frame;
+    samples.append("ID3" + QByteArray(1, 4) + QByteArray(1, '\0') + char(0x40) + syncSafe(body.size()) + body + "audio");
+
+    QByteArray const picture = bigEndian(3, 4) + bigEndian(10, 4) + "image/jpeg" + bigEndian(0, 4) + QByteArray(16, '\0') +
+            bigEndian(image.size(), 4) + image;
+    samples.append("fLaC" + QByteArray(1, '\0') + bigEndian(34, 3) + QByteArray(34, '\0') +
+                   char(0x80 | 6) + bigEndian(picture.size(), 3) + picture);
+
+    QByteArray const covr = atom("covr", atom("data", bigEndian(13, 4) + bigEndian(0, 4) + image));
+    QByteArray const meta = atom("meta", QByteArray(4, '\0') + atom("hdlr", QByteArray(25, '\0')) + atom("ilst", covr));
+    samples.append(atom("ftyp", "M4A " + QByteArray(4, '\0')) + atom("moov", atom("mvhd", QByteArray(100, '\0')) + atom("udta", meta)) +
+                   atom("mdat", QByteArray(64, 'x')));
+
+    return samples;
+}
+
+int fuzzCoverArt(int iterations)
+{
+    QByteArray image("\xff\xd8\xff\xe0");
+    for (int i = 0; i < 512; ++i)
+        image.append(char(i % 3 == 0 ? 0xff : i));
+    image.append("\xff\xd9");
+
+    QList<QByteArray> const samples = coverArtSamples(image);
+    int failures = 0;
+
+    for (int i = 0; i < samples.size(); ++i)
+    {
+        CoverArtScanner::Picture picture;
+        bool const found = CoverArtScanner::scan(samples.at(i), picture) && picture.size == image.size() &&
+                std::memcmp(picture.data, image.constData(), image.size()) == 0 && picture.format &&
+                std::strcmp(picture.format, "JPEG") == 0;
+        if (!found)
+        {
+            std::fprintf(stderr, "fuzz-cover-art: sample %d not recognised\n", i);
+            ++failures;
+        }
+    }
+
+    std::mt19937 random(1);
+    int pictures = 0;
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        std::vector<char> data;
+        {
+            QByteArray const& sample = samples.at(random() % samples.size());
+            data.assign(sample.constData(), sample.constData() + sample.size());
+        }
+
+        int const mutations = 1 + random() % COVER_ART_FUZZ_MAX_MUTATIONS;
+        for (int i = 0; i < mutations && !data.empty(); ++i)
+        {
+            size_t const position = random() % data.size();
+            switch (random() % 4) {
+            case 0:
+                data[position] = char(random());
+                break;
+            case 1:
+                data.resize(position);
+                break;
+            case 2:
+                data.insert(data.begin() + position, char(random()));
+                break;
+            default:
+                data[position] = char(0xff);
+                break;
+            }
+        }
+
+        CoverArtScanner::Picture picture;
+        if (!CoverArtScanner::scan(data.data(), data.size(), picture))
+            continue;
+
+        ++pictures;
+        const char * const first = picture.decoded.isEmpty() ? data.data() : picture.decoded.constData();
+        const char * const last = first + (picture.decoded.isEmpty() ? int(data.size()) : picture.decoded.size());
+        if (picture.size <= 0 || picture.data < first || picture.data + picture.size > last)
+        {
+            std::fprintf(stderr, "fuzz-cover-art: picture out of bounds in iteration %d\n", iteration);
+            return 1;
+        }
+    }
+
+    std::printf("fuzz-cover-art: %s, %d iterations, %d pictures found\n", failures ? "FAILED" : "PASSED",
+                iterations, pictures);
+    return failures ? 1 : 0;
+}
+
+//! The TagLib path the scanner replaced, for comparison
+static int readCoverWithTagLib(const QByteArray& media)
+{
+    QTemporaryFile mediaFile;
+    if (!mediaFile.open())
+        return 0;
+
+    mediaFile.write(media);
+    mediaFile.flush();
+    mediaFile.close();
+    TagLib::MPEG::File file(mediaFile.fileName().toStdString().c_str());
+
+    TagLib::ID3v2::Tag *tag = file.ID3v2Tag();
+    if (!tag)
+        return 0;
+
+    TagLib::ID3v2::FrameList frames = tag->frameListMap()["APIC"];
+    if (frames.isEmpty())
+        return 0;
+
+    return static_cast<TagLib::ID3v2::AttachedPictureFrame*>(frames.front())->picture().size();
+}
+
+int benchmarkCoverArt(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        std::fprintf(stderr, "benchmark-cover-art: cannot read %s\n", qPrintable(fileName));
+        return 1;
+    }
+
+    QByteArray const media = file.readAll();
+    QElapsedTimer timer;
+    int size = 0;
+
+    timer.start();
+    for (int round = 0; round < COVER_ART_BENCHMARK_ROUNDS; ++round)
+    {
+        CoverArtScanner::Picture picture;
+        CoverArtScanner::scan(media, picture);
+        size = picture.size;
+    }
+    double const scanner = double(timer.nsecsElapsed()) / COVER_ART_BENCHMARK_ROUNDS / 1000.0;
+
+    int tagLibSize = 0;
+    timer.restart();
+    for (int round = 0; round < COVER_ART_BENCHMARK_ROUNDS; ++round)
+        tagLibSize = readCoverWithTagLib(media);
+    double const tagLib = double(timer.nsecsElapsed()) / COVER_ART_BENCHMARK_ROUNDS / 1000.0;
+
+    std::printf("cover-art: scanner %.1f us (%d bytes), TagLib %.1f us (%d bytes), %lld byte file\n",
+                scanner, size, tagLib, tagLibSize, static_cast<long long>(media.size()));
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <QString>
+
+//! Each prints its result on stdout and returns the exit status
+
+//! Cost of the equalizer per second of 44.1 kHz stereo audio
+int benchmarkEqualizer();
+
+//! Time to find the cover of an MP3 held in memory, scanner against TagLib
+int benchmarkCoverArt(const QString& fileName);
+
+//! Mutated and truncated samples must never make the scanner read out of
+//! bounds; run under AddressSanitizer to catch what this cannot
+int fuzzCoverArt(int iterations);
+
+#endif // BENCHMARKS_H
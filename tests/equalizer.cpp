@@ -0,0 +1,318 @@
+#include "equalizer.h"
+
+#include <QtMath>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const float Equalizer::MIN_GAIN = -12.0f;
+const float Equalizer::MAX_GAIN = 12.0f;
+
+static const float BAND_FREQUENCIES[Equalizer::BandCount] =
+{
+    31.25f, 62.5f, 125.0f, 250.0f, 500.0f, 1000.0f, 2000.0f, 4000.0f, 8000.0f, 16000.0f
+};
+
+//! One octave per band
+static const double BAND_Q = 1.41;
+static const float FLAT_THRESHOLD = 0.05f;
+static const int DEFAULT_SAMPLE_RATE = 44100;
+static const int PENDING_INDEX = 0x3;
+static const int PENDING_FRESH = 0x4;
+
+struct EqualizerPreset
+{
+    const char *name;
+    float gains[Equalizer::BandCount];
+};
+
+static const EqualizerPreset PRESETS[] =
+{
+    { "Flat", { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 } },
+    { "Rock", { 5, 4, 3, 1, -1, -1, 1, 3, 4, 5 } },
+    { "Pop", { -1, 1, 3, 4, 3, 0, -1, -1, 1, 2 } },
+    { "Jazz", { 3, 2, 1, 2, -1, -1, 0, 1, 2, 3 } },
+    { "Classical", { 4, 3, 2, 1, -1, -1, 0, 2, 3, 4 } },
+    { "Dance", { 6, 5, 2, 0, 0, -2, -2, -2, 0, 0 } },
+    { "Bass Boost", { 7, 6, 4, 2, 0, 0, 0, 0, 0, 0 } },
+    { "Treble Boost", { 0, 0, 0, 0, 0, 1, 3, 5, 6, 7 } },
+    { "Vocal", { -2, -3, -3, 1, 4, 4, 3, 1, 0, -2 } },
+    { "Loudness", { 5, 4, 1, 0, -2, 0, -1, 0, 4, 2 } }
+};
+
+static const int PRESET_COUNT = sizeof(PRESETS) / sizeof(PRESETS[0]);
+
+Equalizer::Equalizer() : sampleRate_(DEFAULT_SAMPLE_RATE), backCoefficients_(0), frontCoefficients_(1),
+    pendingCoefficients_(2), flat_(true), processedFlat_(true)
+{
+    std::fill(gains_, gains_ + BandCount, 0.0f);
+    reset();
+    publishCoefficients();
+}
+
+float Equalizer::bandFrequency(int band)
+{
+    Q_ASSERT(band >= 0 && band < BandCount);
+    return BAND_FREQUENCIES[band];
+}
+
+QStringList Equalizer::presetNames()
+{
+    QStringList names;
+    for (int i = 0; i < PRESET_COUNT; ++i)
+        names.append(PRESETS[i].name);
+    return names;
+}
+
+QVector<float> Equalizer::presetGains(const QString &name)
+{
+    for (int i = 0; i < PRESET_COUNT; ++i)
+    {
+        if (name == PRESETS[i].name)
+        {
+            QVector<float> gains(BandCount);
+            std::copy(PRESETS[i].gains, PRESETS[i].gains + BandCount, gains.begin());
+            return gains;
+        }
+    }
+
+    return QVector<float>(BandCount, 0.0f);
+}
+
+void Equalizer::setSampleRate(int sampleRate)
+{
+    Q_ASSERT(sampleRate > 0);
+
+    if (sampleRate == sampleRate_)
+        return;
+
+    sampleRate_ = sampleRate;
+    reset();
+    publishCoefficients();
+}
+
+int Equalizer::sampleRate() const
+{
+    return sampleRate_;
+}
+
+void Equalizer::setGain(int band, float decibels)
+{
+    Q_ASSERT(band >= 0 && band < BandCount);
+
+    gains_[band] = qBound(MIN_GAIN, decibels, MAX_GAIN);
+    publishCoefficients();
+}
+
+void Equalizer::setGains(const QVector<float> &decibels)
+{
+    for (int band = 0; band < BandCount; ++band)
+        gains_[band] = qBound(MIN_GAIN, decibels.value(band), MAX_GAIN);
+
+    publishCoefficients();
+}
+
+float Equalizer::gain(int band) const
+{
+    Q_ASSERT(band >= 0 && band < BandCount);
+    return gains_[band];
+}
+
+QVector<float> Equalizer::gains() const
+{
+    QVector<float> gains(BandCount);
+    std::copy(gains_, gains_ + BandCount, gains.begin());
+    return gains;
+}
+
+bool Equalizer::isFlat() const
+{
+    return flat_;
+}
+
+int Equalizer::latency() const
+{
+#ifdef __SSE2__
+    return StageCount;
+#else
+    return 0;
+#endif
+}
+
+void Equalizer::process(float *samples, int frames, int channels)
+{
+    if (pendingCoefficients_.loadAcquire() & PENDING_FRESH)
+        frontCoefficients_ = pendingCoefficients_.fetchAndStoreOrdered(frontCoefficients_) & PENDING_INDEX;
+
+    Coefficients const& coefficients = coefficients_[frontCoefficients_];
+
+    //! Flat settings are bypassed; the filter state is cleared once so that
+    //! re-enabling does not replay a stale tail
+    if (coefficients.flat)
+    {
+        if (!processedFlat_)
+        {
+            reset();
+            processedFlat_ = true;
+        }
+        return;
+    }
+
+    processedFlat_ = false;
+
+#ifdef __SSE2__
+    //! Recursive filters decaying into silence would otherwise hit denormals
+    unsigned int const csr = _mm_getcsr();
+    _mm_setcsr(csr | 0x8040);
+
+    if (channels == 2)
+        processStereo(coefficients, samples, frames);
+    else
+        processScalar(coefficients, samples, frames, channels);
+
+    _mm_setcsr(csr);
+#else
+    processScalar(coefficients, samples, frames, channels);
+#endif
+}
+
+void Equalizer::reset()
+{
+    std::memset(z1_, 0, sizeof(z1_));
+    std::memset(z2_, 0, sizeof(z2_));
+    std::memset(carry_, 0, sizeof(carry_));
+    std::memset(scalarZ1_, 0, sizeof(scalarZ1_));
+    std::memset(scalarZ2_, 0, sizeof(scalarZ2_));
+}
+
+void Equalizer::publishCoefficients()
+{
+    Coefficients& coefficients = coefficients_[backCoefficients_];
+    bool flat = true;
+
+    for (int band = 0; band < BandCount; ++band)
+    {
+        //! RBJ peaking filter; bands above Nyquist stay at unity
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+        double const frequency = BAND_FREQUENCIES[band];
+
+        if (qAbs(gains_[band]) >= FLAT_THRESHOLD && frequency < sampleRate_ / 2.0)
+        {
+            double const amplitude = qPow(10.0, gains_[band] / 40.0);
+            double const omega = 2.0 * M_PI * frequency / sampleRate_;
+            double const alpha = qSin(omega) / (2.0 * BAND_Q);
+            double const cosine = qCos(omega);
+            double const a0 = 1.0 + alpha / amplitude;
+
+            b0 = (1.0 + alpha * amplitude) / a0;
+            b1 = -2.0 * cosine / a0;
+            b2 = (1.0 - alpha * amplitude) / a0;
+            a1 = -2.0 * cosine / a0;
+            a2 = (1.0 - alpha / amplitude) / a0;
+            flat = false;
+        }
+
+        int const stage = band / 2;
+        int const lane = (band % 2) * 2;
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            coefficients.b0[stage][lane + channel] = float(b0);
+            coefficients.b1[stage][lane + channel] = float(b1);
+            coefficients.b2[stage][lane + channel] = float(b2);
+            coefficients.a1[stage][lane + channel] = float(a1);
+            coefficients.a2[stage][lane + channel] = float(a2);
+        }
+    }
+
+    coefficients.flat = flat;
+    flat_ = flat;
+    backCoefficients_ = pendingCoefficients_.fetchAndStoreOrdered(backCoefficients_ | PENDING_FRESH) & PENDING_INDEX;
+}
+
+void Equalizer::processStereo(const Equalizer::Coefficients &coefficients, float *samples, int frames)
+{
+#ifdef __SSE2__
+    __m128 b0[StageCount], b1[StageCount], b2[StageCount], a1[StageCount], a2[StageCount];
+    __m128 z1[StageCount], z2[StageCount], carry[StageCount];
+
+    for (int stage = 0; stage < StageCount; ++stage)
+    {
+        b0[stage] = _mm_loadu_ps(coefficients.b0[stage]);
+        b1[stage] = _mm_loadu_ps(coefficients.b1[stage]);
+        b2[stage] = _mm_loadu_ps(coefficients.b2[stage]);
+        a1[stage] = _mm_loadu_ps(coefficients.a1[stage]);
+        a2[stage] = _mm_loadu_ps(coefficients.a2[stage]);
+        z1[stage] = _mm_loadu_ps(z1_[stage]);
+        z2[stage] = _mm_loadu_ps(z2_[stage]);
+        carry[stage] = _mm_loadu_ps(carry_[stage]);
+    }
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        float * const sample = samples + 2 * frame;
+        __m128 in = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(sample));
+
+        for (int stage = 0; stage < StageCount; ++stage)
+        {
+            //! [left, right] of this frame for the first band and the first
+            //! band's previous output for the second one
+            __m128 const x = _mm_movelh_ps(in, carry[stage]);
+            __m128 const y = _mm_add_ps(_mm_mul_ps(b0[stage], x), z1[stage]);
+            z1[stage] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1[stage], x), _mm_mul_ps(a1[stage], y)), z2[stage]);
+            z2[stage] = _mm_sub_ps(_mm_mul_ps(b2[stage], x), _mm_mul_ps(a2[stage], y));
+            carry[stage] = y;
+            in = _mm_movehl_ps(y, y);
+        }
+
+        _mm_storel_pi(reinterpret_cast<__m64*>(sample), in);
+    }
+
+    for (int stage = 0; stage < StageCount; ++stage)
+    {
+        _mm_storeu_ps(z1_[stage], z1[stage]);
+        _mm_storeu_ps(z2_[stage], z2[stage]);
+        _mm_storeu_ps(carry_[stage], carry[stage]);
+    }
+#else
+    processScalar(coefficients, samples, frames, 2);
+#endif
+}
+
+void Equalizer::processScalar(const Equalizer::Coefficients &coefficients, float *samples, int frames, int channels)
+{
+    int const filtered = qMin<int>(channels, ScalarMaxChannels);
+
+    for (int band = 0; band < BandCount; ++band)
+    {
+        int const stage = band / 2;
+        int const lane = (band % 2) * 2;
+        float const b0 = coefficients.b0[stage][lane];
+        float const b1 = coefficients.b1[stage][lane];
+        float const b2 = coefficients.b2[stage][lane];
+        float const a1 = coefficients.a1[stage][lane];
+        float const a2 = coefficients.a2[stage][lane];
+
+        for (int channel = 0; channel < filtered; ++channel)
+        {
+            float z1 = scalarZ1_[band][channel];
+            float z2 = scalarZ2_[band][channel];
+
+            for (int frame = 0; frame < frames; ++frame)
+            {
+                float& sample = samples[frame * channels + channel];
+                float const x = sample;
+                float const y = b0 * x + z1;
+                z1 = b1 * x - a1 * y + z2;
+                z2 = b2 * x - a2 * y;
+                sample = y;
+            }
+
+            scalarZ1_[band][channel] = z1;
+            scalarZ2_[band][channel] = z2;
+        }
+    }
+}
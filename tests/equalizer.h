@@ -0,0 +1,88 @@
+#ifndef EQUALIZER_H
+#define EQUALIZER_H
+
+#include <QAtomicInt>
+#include <QStringList>
+#include <QVector>
+
+//! Ten octave-band peaking equalizer as a cascade of biquads. For stereo
+//! the SSE2 path runs both channels and two neighbouring bands in one
+//! register, the second band one frame behind the first, so the cascade
+//! adds a fixed latency() of BandCount / 2 frames. process() never
+//! allocates or locks; coefficients are triple buffered, so the writer
+//! never touches the set the audio thread is reading and new gains are
+//! picked up at the next block.
+class Equalizer
+{
+public:
+    enum
+    {
+        BandCount = 10,
+        StageCount = BandCount / 2,
+        ScalarMaxChannels = 8
+    };
+
+    static const float MIN_GAIN;
+    static const float MAX_GAIN;
+
+    Equalizer();
+
+    static float bandFrequency(int band);
+    static QStringList presetNames();
+    static QVector<float> presetGains(const QString& name);
+
+    void setSampleRate(int sampleRate);
+    int sampleRate() const;
+
+    void setGain(int band, float decibels);
+    void setGains(const QVector<float>& decibels);
+    float gain(int band) const;
+    QVector<float> gains() const;
+
+    bool isFlat() const;
+    int latency() const;
+
+    //! Interleaved samples, processed in place
+    void process(float *samples, int frames, int channels);
+    void reset();
+
+private:
+    struct Coefficients
+    {
+        //! Per stage and coefficient: first band left, right, second band left, right
+        float b0[StageCount][4];
+        float b1[StageCount][4];
+        float b2[StageCount][4];
+        float a1[StageCount][4];
+        float a2[StageCount][4];
+        bool flat;
+    };
+
+    void publishCoefficients();
+    void processStereo(const Coefficients& coefficients, float *samples, int frames);
+    void processScalar(const Coefficients& coefficients, float *samples, int frames, int channels);
+
+    float gains_[BandCount];
+    int sampleRate_;
+
+    //! The writer owns backCoefficients_, process() owns frontCoefficients_
+    //! and the third set is handed over through pendingCoefficients_, whose
+    //! PENDING_FRESH bit tells the reader that it holds newer gains
+    Coefficients coefficients_[3];
+    int backCoefficients_;
+    int frontCoefficients_;
+    QAtomicInt pendingCoefficients_;
+    bool flat_;
+    bool processedFlat_;
+
+    //! Transposed direct form II state, lanes as in Coefficients
+    float z1_[StageCount][4];
+    float z2_[StageCount][4];
+    //! Previous output of the first band of every stage
+    float carry_[StageCount][4];
+    //! Scalar path state; channels past ScalarMaxChannels pass through
+    float scalarZ1_[BandCount][ScalarMaxChannels];
+    float scalarZ2_[BandCount][ScalarMaxChannels];
+};
+
+#endif // EQUALIZER_H
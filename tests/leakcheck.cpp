@@ -0,0 +1,72 @@
+#include "leakcheck.h"
+#include "mediacomponent.h"
+
+#include <QCoreApplication>
+#include <QTimer>
+
+#include <cstdio>
+
+static const int LEAK_CHECK_TRACK_INTERVAL = 3000;
+static const int LEAK_CHECK_WARM_UP_CHANGES = 2;
+
+LeakCheck::LeakCheck(MediaComponent *media, int trackChanges, QObject *parent) : QObject(parent),
+    media_(media), timer_(new QTimer(this)), trackChanges_(trackChanges), changed_(0), started_(false)
+{
+    Q_ASSERT(media);
+
+    timer_->setInterval(LEAK_CHECK_TRACK_INTERVAL);
+    connect(timer_, &QTimer::timeout, this, &LeakCheck::changeTrack);
+}
+
+bool LeakCheck::isStarted() const
+{
+    return started_;
+}
+
+void LeakCheck::start()
+{
+    if (started_)
+        return;
+
+    started_ = true;
+    timer_->start();
+}
+
+void LeakCheck::changeTrack()
+{
+    if (changed_ == LEAK_CHECK_WARM_UP_CHANGES)
+        baseline_ = ResourceMonitor::snapshot();
+
+    if (changed_ == LEAK_CHECK_WARM_UP_CHANGES + trackChanges_)
+    {
+        finish();
+        return;
+    }
+
+    media_->next();
+    ++changed_;
+}
+
+void LeakCheck::finish()
+{
+    timer_->stop();
+
+    ResourceMonitor::Snapshot const current = ResourceMonitor::snapshot();
+    bool flat = true;
+
+    for (int i = 0; i < ResourceMonitor::ResourceCount; ++i)
+    {
+        //! Model rows follow the playlist contents, not the track changes
+        if (i == ResourceMonitor::ModelRows)
+            continue;
+
+        qint64 const growth = current.count[i] - baseline_.count[i];
+        std::fprintf(stderr, "leak-check: %s %lld -> %lld\n", qPrintable(ResourceMonitor::name(ResourceMonitor::Resource(i))),
+                     static_cast<long long>(baseline_.count[i]), static_cast<long long>(current.count[i]));
+        if (growth > 0)
+            flat = false;
+    }
+
+    std::fprintf(stderr, "leak-check: %s after %d track changes\n", flat ? "PASSED" : "FAILED", trackChanges_);
+    QCoreApplication::exit(flat ? 0 : 1);
+}
@@ -0,0 +1,39 @@
+#ifndef LEAKCHECK_H
+#define LEAKCHECK_H
+
+#include "resourcemonitor.h"
+
+#include <QObject>
+
+class MediaComponent;
+class QTimer;
+
+//! Skips through the current playlist and exits with a non-zero status
+//! when live resource counts grow between the warm-up and the last change
+class LeakCheck : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LeakCheck(MediaComponent *media, int trackChanges, QObject *parent = 0);
+
+    bool isStarted() const;
+
+public slots:
+    void start();
+
+private slots:
+    void changeTrack();
+
+private:
+    void finish();
+
+    MediaComponent *media_;
+    QTimer *timer_;
+    int trackChanges_;
+    int changed_;
+    bool started_;
+    ResourceMonitor::Snapshot baseline_;
+};
+
+#endif // LEAKCHECK_H
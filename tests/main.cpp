@@ -0,0 +1,141 @@
+#include "benchmarks.h"
+#include "leakcheck.h"
+#include "mainwindow.h"
+#include "mockvkserver.h"
+#include "resourcemonitor.h"
+#include "soakdriver.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+
+#include <cstdio>
+
+//! Plays the first playlist that arrives and skips through it
+static void startLeakCheck(MainWindow *window, int trackChanges)
+{
+    LeakCheck *leakCheck = new LeakCheck(window->media(), trackChanges, window);
+    QObject::connect(window->api(), &ApiComponent::playlistReceived, leakCheck, [window, leakCheck]()
+    {
+        if (leakCheck->isStarted())
+            return;
+
+        window->player()->playRow(0);
+        leakCheck->start();
+    }, Qt::QueuedConnection);
+}
+
+//! Goes through the regular sign-in path with a fake token
+static void signIn(MainWindow *window)
+{
+    window->api()->getTokensFromUrl(QUrl("http://localhost/#access_token=soak&expires_in=0&user_id=1"));
+}
+
+//! Runs the scripted actions once the first playlist has arrived
+static void startSoak(MainWindow *window, int actions)
+{
+    SoakDriver *soakDriver = new SoakDriver(window->api(), window->media(), window->player(), actions, window);
+    QObject::connect(window->api(), &ApiComponent::playlistReceived, soakDriver, &SoakDriver::start, Qt::QueuedConnection);
+
+    signIn(window);
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication a(argc, argv);
+    QApplication::setOrganizationName("Flow");
+    QApplication::setApplicationName("Flow");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption dumpResourcesOption("dump-resources", "Print live resource counters on exit.");
+    QCommandLineOption leakCheckOption("leak-check", "Skip through <count> tracks and fail if resources grow; "
+                                       "without --api-base-url an in-process mock server is used.", "count");
+    QCommandLineOption apiBaseUrlOption("api-base-url", "Send API requests to <url> instead of api.vk.com.", "url");
+    QCommandLineOption mockServerOption("mock-server", "Only run the mock VK API and CDN on <port>.", "port");
+    QCommandLineOption mockLatencyOption("mock-latency", "Delay every mock response by <ms>.", "ms", "0");
+    QCommandLineOption mockErrorRateOption("mock-error-rate", "Fail this share of mock responses, 0 to 1.", "rate", "0");
+    QCommandLineOption mockTracksOption("mock-tracks", "Size of the mock catalogue.", "count", "2000");
+    QCommandLineOption soakOption("soak", "Run <count> scripted actions; without --api-base-url an in-process "
+                                  "mock server is used.", "count");
+    QCommandLineOption benchmarkEqualizerOption("benchmark-equalizer", "Measure the equalizer cost and exit.");
+    QCommandLineOption benchmarkCoverArtOption("benchmark-cover-art", "Time finding the cover of <file>, scanner "
+                                               "against TagLib, and exit.", "file");
+    QCommandLineOption fuzzCoverArtOption("fuzz-cover-art", "Scan <count> mutated files for covers and exit.", "count");
+    parser.addOption(dumpResourcesOption);
+    parser.addOption(leakCheckOption);
+    parser.addOption(apiBaseUrlOption);
+    parser.addOption(mockServerOption);
+    parser.addOption(mockLatencyOption);
+    parser.addOption(mockErrorRateOption);
+    parser.addOption(mockTracksOption);
+    parser.addOption(soakOption);
+    parser.addOption(benchmarkEqualizerOption);
+    parser.addOption(benchmarkCoverArtOption);
+    parser.addOption(fuzzCoverArtOption);
+    parser.process(a);
+
+    if (parser.isSet(benchmarkEqualizerOption))
+        return benchmarkEqualizer();
+
+    if (parser.isSet(benchmarkCoverArtOption))
+        return benchmarkCoverArt(parser.value(benchmarkCoverArtOption));
+
+    if (parser.isSet(fuzzCoverArtOption))
+        return fuzzCoverArt(qMax(1, parser.value(fuzzCoverArtOption).toInt()));
+
+    bool const standaloneMockServer = parser.isSet(mockServerOption);
+    bool const inProcessMockServer = (parser.isSet(soakOption) || parser.isSet(leakCheckOption))
+            && !parser.isSet(apiBaseUrlOption);
+
+    if (!standaloneMockServer && !parser.isSet(soakOption) && !parser.isSet(leakCheckOption))
+        parser.showHelp(1);
+
+    MockVkServer *mockServer = 0;
+    if (standaloneMockServer || inProcessMockServer)
+    {
+        mockServer = new MockVkServer(&a);
+        mockServer->setLatency(parser.value(mockLatencyOption).toInt());
+        mockServer->setErrorRate(parser.value(mockErrorRateOption).toDouble());
+        mockServer->setTrackCount(qMax(1, parser.value(mockTracksOption).toInt()));
+
+        quint16 const port = standaloneMockServer ? parser.value(mockServerOption).toUShort() : 0;
+        if (!mockServer->listen(QHostAddress::LocalHost, port))
+        {
+            std::fprintf(stderr, "mock-server: %s\n", qPrintable(mockServer->errorString()));
+            return 1;
+        }
+
+        std::fprintf(stderr, "mock-server: listening on %s\n", qPrintable(mockServer->baseUrl().toString()));
+
+        if (standaloneMockServer)
+            return a.exec();
+    }
+
+    MainWindow w;
+
+    if (mockServer)
+        w.setApiBaseUrl(mockServer->baseUrl());
+    else if (parser.isSet(apiBaseUrlOption))
+        w.setApiBaseUrl(QUrl(parser.value(apiBaseUrlOption)));
+
+    if (parser.isSet(leakCheckOption))
+        startLeakCheck(&w, qMax(1, parser.value(leakCheckOption).toInt()));
+
+    //! Against a real API the leak check waits for a regular sign-in
+    if (parser.isSet(soakOption))
+        startSoak(&w, qMax(1, parser.value(soakOption).toInt()));
+    else if (mockServer)
+        signIn(&w);
+    else
+    {
+        setWidgetOnCenterScreen(&w);
+        w.show();
+    }
+
+    int const result = a.exec();
+
+    if (parser.isSet(dumpResourcesOption))
+        std::fprintf(stderr, "%s\n", qPrintable(ResourceMonitor::report()));
+
+    return result;
+}
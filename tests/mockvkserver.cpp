@@ -0,0 +1,464 @@
+#include "mockvkserver.h"
+
+#include <QBuffer>
+#include <QImage>
+#include <QLinearGradient>
+#include <QPainter>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrlQuery>
+#include <QXmlStreamWriter>
+
+static const int DEFAULT_TRACK_COUNT = 2000;
+static const int DEFAULT_PLAYLIST_COUNT = 500;
+static const qint64 BODY_CHUNK_SIZE = 64 * 1024;
+static const int COVER_SIZE = 300;
+static const int RATE_LIMIT_ERROR_CODE = 6;
+static const int UNKNOWN_METHOD_ERROR_CODE = 3;
+
+//! MPEG-1 Layer III, 128 kbps, 44100 Hz, no padding; the zeroed payload decodes to silence
+static const char MPEG_FRAME_HEADER[] = { '\xff', '\xfb', '\x90', '\x00' };
+static const int MPEG_FRAME_HEADER_SIZE = 4;
+static const int MPEG_FRAME_SIZE = 417;
+static const int MPEG_SAMPLE_RATE = 44100;
+static const int MPEG_FRAME_SAMPLES = 1152;
+
+static const char * const ARTISTS[] =
+{
+    "Кино", "Ария", "Сплин", "Мумий Тролль", "Земфира", "Би-2", "Ночные Снайперы", "Пикник",
+    "The Night Owls", "Summer Rain", "Lost Cities", "Paper Stars", "Northern Lights", "Blue Harbour",
+    "Electric Fields", "Morning Tide"
+};
+
+static const char * const WORDS[] =
+{
+    "love", "night", "city", "rain", "summer", "star", "road", "fire", "dream", "heart",
+    "ночь", "город", "дождь", "лето", "звезда", "дорога", "огонь", "сон", "сердце", "небо"
+};
+
+MockVkServer::MockVkServer(QObject *parent) : QTcpServer(parent), latency_(0), errorRate_(0.0),
+    random_(std::random_device()())
+{
+    generateCatalogue(DEFAULT_TRACK_COUNT);
+    generateTag();
+}
+
+void MockVkServer::setLatency(int milliseconds)
+{
+    Q_ASSERT(milliseconds >= 0);
+    latency_ = milliseconds;
+}
+
+void MockVkServer::setErrorRate(double rate)
+{
+    errorRate_ = qBound(0.0, rate, 1.0);
+}
+
+void MockVkServer::setTrackCount(int count)
+{
+    Q_ASSERT(count > 0);
+    generateCatalogue(count);
+}
+
+QUrl MockVkServer::baseUrl() const
+{
+    QUrl url;
+    url.setScheme("http");
+    url.setHost("127.0.0.1");
+    url.setPort(serverPort());
+    return url;
+}
+
+void MockVkServer::incomingConnection(qintptr socketDescriptor)
+{
+    QTcpSocket *socket = new QTcpSocket(this);
+    if (!socket->setSocketDescriptor(socketDescriptor))
+    {
+        delete socket;
+        return;
+    }
+
+    connections_.insert(socket, Connection());
+
+    connect(socket, &QTcpSocket::readyRead, this, &MockVkServer::readRequests);
+    connect(socket, &QTcpSocket::bytesWritten, this, &MockVkServer::writeBody);
+    connect(socket, &QTcpSocket::disconnected, this, &MockVkServer::dropConnection);
+}
+
+void MockVkServer::readRequests()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket || !connections_.contains(socket))
+        return;
+
+    connections_[socket].buffer += socket->readAll();
+    processRequest(socket);
+}
+
+void MockVkServer::writeBody()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (socket && connections_.contains(socket))
+        pumpBody(socket);
+}
+
+void MockVkServer::dropConnection()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket)
+        return;
+
+    connections_.remove(socket);
+    socket->deleteLater();
+}
+
+void MockVkServer::processRequest(QTcpSocket *socket)
+{
+    Connection& connection = connections_[socket];
+
+    //! One request at a time per connection, so responses keep their order
+    if (connection.busy)
+        return;
+
+    int const headerEnd = connection.buffer.indexOf("\r\n\r\n");
+    if (headerEnd < 0)
+        return;
+
+    QList<QByteArray> const lines = connection.buffer.left(headerEnd).split('\n');
+    connection.buffer.remove(0, headerEnd + 4);
+
+    QList<QByteArray> const requestLine = lines.first().trimmed().split(' ');
+    QByteArray const path = requestLine.value(1);
+    QByteArray range;
+
+    for (int i = 1; i < lines.size(); ++i)
+    {
+        QByteArray const line = lines.at(i).trimmed();
+        int const separator = line.indexOf(':');
+        QByteArray const name = line.left(separator).trimmed().toLower();
+        QByteArray const value = line.mid(separator + 1).trimmed();
+
+        if (name == "range")
+            range = value;
+        else if (name == "connection" && value.toLower() == "close")
+            connection.closeWhenDone = true;
+    }
+
+    connection.busy = true;
+    QTimer::singleShot(latency_, socket, [this, socket, path, range]()
+    {
+        respond(socket, path, range);
+    });
+}
+
+void MockVkServer::pumpBody(QTcpSocket *socket)
+{
+    Connection& connection = connections_[socket];
+    if (connection.offset >= connection.end || socket->bytesToWrite() >= BODY_CHUNK_SIZE)
+        return;
+
+    qint64 const length = qMin(BODY_CHUNK_SIZE, connection.end - connection.offset);
+    qint64 const tagSize = tag_.size();
+    QByteArray chunk(int(length), '\0');
+    char *data = chunk.data();
+
+    for (qint64 i = 0; i < length; ++i)
+    {
+        qint64 const position = connection.offset + i;
+        if (position < tagSize)
+            data[i] = tag_.at(int(position));
+        else
+        {
+            int const frameOffset = int((position - tagSize) % MPEG_FRAME_SIZE);
+            if (frameOffset < MPEG_FRAME_HEADER_SIZE)
+                data[i] = MPEG_FRAME_HEADER[frameOffset];
+        }
+    }
+
+    connection.offset += length;
+    socket->write(chunk);
+
+    if (connection.offset >= connection.end)
+        finishResponse(socket);
+}
+
+void MockVkServer::respond(QTcpSocket *socket, const QByteArray &path, const QByteArray &range)
+{
+    if (!connections_.contains(socket))
+        return;
+
+    QUrl const url = QUrl::fromEncoded(path);
+    QString const file = url.path();
+
+    if (file.startsWith("/method/"))
+        respondApi(socket, url);
+    else if (file.startsWith("/cdn/") && file.endsWith(".mp3"))
+        respondTrack(socket, file.mid(5, file.size() - 9).toInt(), range);
+    else
+    {
+        writeHead(socket, 404, "Not Found", QList<QPair<QByteArray, QByteArray> >(), 0);
+        finishResponse(socket);
+    }
+}
+
+void MockVkServer::respondApi(QTcpSocket *socket, const QUrl &url)
+{
+    QString const method = url.path().mid(8).remove(".xml");
+    QUrlQuery const query(url);
+    int const count = query.hasQueryItem("count") ? query.queryItemValue("count").toInt() : DEFAULT_PLAYLIST_COUNT;
+
+    QByteArray body;
+    QList<const Track*> tracks;
+
+    if (failRandomly())
+    {
+        body = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<error><error_code>" + QByteArray::number(RATE_LIMIT_ERROR_CODE) +
+               "</error_code><error_msg>Too many requests per second</error_msg></error>";
+    }
+    else if (method == "audio.get")
+    {
+        for (int i = 0; i < tracks_.size() && tracks.size() < count; ++i)
+            tracks.append(&tracks_.at(i));
+    }
+    else if (method == "audio.getRecommendations" || method == "audio.getPopular")
+    {
+        QString seed = query.queryItemValue("uid");
+        if (method == "audio.getPopular")
+            seed = query.queryItemValue("genre_id");
+        else if (query.hasQueryItem("target_audio"))
+            seed = query.queryItemValue("target_audio");
+
+        int const offset = query.queryItemValue("offset").toInt();
+        int const first = int((qHash(method + seed) + uint(qMax(0, offset))) % uint(tracks_.size()));
+        for (int i = 0; i < tracks_.size() && tracks.size() < count; ++i)
+            tracks.append(&tracks_.at((first + i) % tracks_.size()));
+    }
+    else if (method == "audio.getById")
+    {
+        QStringList const audios = query.queryItemValue("audios").split(',', QString::SkipEmptyParts);
+        foreach (const QString& audio, audios)
+        {
+            bool ok = false;
+            int const id = audio.section('_', 1).toInt(&ok);
+            if (ok && id >= 0 && id < tracks_.size())
+                tracks.append(&tracks_.at(id));
+        }
+    }
+    else if (method == "audio.search")
+    {
+        QString const text = query.queryItemValue("q", QUrl::FullyDecoded);
+        bool const artistOnly = query.queryItemValue("performer_only") == "1";
+
+        for (int i = 0; i < tracks_.size() && tracks.size() < count; ++i)
+        {
+            Track const& track = tracks_.at(i);
+            if (track.artist.contains(text, Qt::CaseInsensitive) ||
+                    (!artistOnly && track.title.contains(text, Qt::CaseInsensitive)))
+                tracks.append(&track);
+        }
+    }
+    else
+    {
+        body = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<error><error_code>" + QByteArray::number(UNKNOWN_METHOD_ERROR_CODE) +
+               "</error_code><error_msg>Unknown method passed</error_msg></error>";
+    }
+
+    if (body.isEmpty())
+        body = playlistXml(tracks);
+
+    QList<QPair<QByteArray, QByteArray> > headers;
+    headers.append(qMakePair(QByteArray("Content-Type"), QByteArray("application/xml; charset=utf-8")));
+    writeHead(socket, 200, "OK", headers, body.size());
+    socket->write(body);
+    finishResponse(socket);
+}
+
+void MockVkServer::respondTrack(QTcpSocket *socket, int id, const QByteArray &range)
+{
+    if (id < 0 || id >= tracks_.size() || failRandomly())
+    {
+        writeHead(socket, 503, "Service Unavailable", QList<QPair<QByteArray, QByteArray> >(), 0);
+        finishResponse(socket);
+        return;
+    }
+
+    Track const& track = tracks_.at(id);
+    qint64 const size = trackSize(track);
+    qint64 first = 0;
+    qint64 last = size - 1;
+    bool const partial = range.startsWith("bytes=");
+
+    if (partial)
+    {
+        QList<QByteArray> const bounds = range.mid(6).split('-');
+        first = bounds.value(0).toLongLong();
+        if (!bounds.value(1).isEmpty())
+            last = qMin(last, bounds.value(1).toLongLong());
+
+        if (first >= size || first > last)
+        {
+            QList<QPair<QByteArray, QByteArray> > headers;
+            headers.append(qMakePair(QByteArray("Content-Range"), "bytes */" + QByteArray::number(size)));
+            writeHead(socket, 416, "Range Not Satisfiable", headers, 0);
+            finishResponse(socket);
+            return;
+        }
+    }
+
+    QList<QPair<QByteArray, QByteArray> > headers;
+    headers.append(qMakePair(QByteArray("Content-Type"), QByteArray("audio/mpeg")));
+    headers.append(qMakePair(QByteArray("Accept-Ranges"), QByteArray("bytes")));
+    if (partial)
+    {
+        headers.append(qMakePair(QByteArray("Content-Range"), "bytes " + QByteArray::number(first) + "-" +
+                                 QByteArray::number(last) + "/" + QByteArray::number(size)));
+    }
+
+    writeHead(socket, partial ? 206 : 200, partial ? "Partial Content" : "OK", headers, last - first + 1);
+
+    Connection& connection = connections_[socket];
+    connection.offset = first;
+    connection.end = last + 1;
+
+    //! The body is generated in chunks as the socket drains
+    pumpBody(socket);
+}
+
+void MockVkServer::writeHead(QTcpSocket *socket, int status, const QByteArray &reason,
+                             const QList<QPair<QByteArray, QByteArray> > &headers, qint64 length)
+{
+    Connection const& connection = connections_[socket];
+
+    QByteArray head = "HTTP/1.1 " + QByteArray::number(status) + " " + reason + "\r\n";
+    for (int i = 0; i < headers.size(); ++i)
+        head += headers.at(i).first + ": " + headers.at(i).second + "\r\n";
+    head += "Content-Length: " + QByteArray::number(length) + "\r\n";
+    head += connection.closeWhenDone ? "Connection: close\r\n\r\n" : "Connection: keep-alive\r\n\r\n";
+
+    socket->write(head);
+}
+
+void MockVkServer::finishResponse(QTcpSocket *socket)
+{
+    Connection& connection = connections_[socket];
+    connection.busy = false;
+
+    if (connection.closeWhenDone)
+        socket->disconnectFromHost();
+    else if (!connection.buffer.isEmpty())
+        processRequest(socket);
+}
+
+QByteArray MockVkServer::playlistXml(const QList<const Track*> &tracks)
+{
+    QByteArray xml;
+    QXmlStreamWriter writer(&xml);
+    QString const base = baseUrl().toString();
+
+    writer.writeStartDocument();
+    writer.writeStartElement("response");
+    writer.writeAttribute("list", "true");
+
+    foreach (const Track *track, tracks)
+    {
+        writer.writeStartElement("audio");
+        writer.writeTextElement("aid", QString::number(track->id));
+        writer.writeTextElement("owner_id", "1");
+        writer.writeTextElement("artist", track->artist);
+        writer.writeTextElement("title", track->title);
+        writer.writeTextElement("duration", QString::number(track->duration));
+        //! Real stream urls are signed, so every listing gets a fresh query
+        writer.writeTextElement("url", base + "/cdn/" + QString::number(track->id) + ".mp3?extra=" +
+                                QString::number(quint32(random_()), 16));
+        writer.writeEndElement();
+    }
+
+    writer.writeEndElement();
+    writer.writeEndDocument();
+
+    return xml;
+}
+
+qint64 MockVkServer::trackSize(const MockVkServer::Track &track) const
+{
+    return tag_.size() + qint64(frameCount(track)) * MPEG_FRAME_SIZE;
+}
+
+int MockVkServer::frameCount(const MockVkServer::Track &track) const
+{
+    return int(qint64(track.duration) * MPEG_SAMPLE_RATE / MPEG_FRAME_SAMPLES);
+}
+
+bool MockVkServer::failRandomly()
+{
+    if (errorRate_ <= 0.0)
+        return false;
+
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    return distribution(random_) < errorRate_;
+}
+
+void MockVkServer::generateCatalogue(int count)
+{
+    int const artistCount = sizeof(ARTISTS) / sizeof(ARTISTS[0]);
+    int const wordCount = sizeof(WORDS) / sizeof(WORDS[0]);
+
+    tracks_.clear();
+    tracks_.reserve(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        Track track;
+        track.id = i;
+        track.artist = QString::fromUtf8(ARTISTS[i % artistCount]);
+        track.title = QString::fromUtf8(WORDS[(i * 7) % wordCount]) + " " + QString::fromUtf8(WORDS[(i * 13 + 3) % wordCount]);
+        track.duration = 90 + (i * 37) % 240;
+        tracks_.append(track);
+    }
+}
+
+void MockVkServer::generateTag()
+{
+    QImage cover(COVER_SIZE, COVER_SIZE, QImage::Format_RGB32);
+    {
+        QPainter painter(&cover);
+        QLinearGradient gradient(0, 0, COVER_SIZE, COVER_SIZE);
+        gradient.setColorAt(0.0, QColor(0x2a, 0x5c, 0x8a));
+        gradient.setColorAt(1.0, QColor(0xe0, 0x8a, 0x3c));
+        painter.fillRect(cover.rect(), gradient);
+    }
+
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    cover.save(&buffer, "PNG");
+
+    //! ID3v2.3 APIC: encoding, mime type, picture type (front cover), empty description
+    QByteArray frame;
+    frame += '\0';
+    frame += QByteArray("image/png") + '\0';
+    frame += '\x03';
+    frame += '\0';
+    frame += png;
+
+    quint32 const frameSize = frame.size();
+    QByteArray frameHeader = "APIC";
+    frameHeader += char(frameSize >> 24);
+    frameHeader += char(frameSize >> 16);
+    frameHeader += char(frameSize >> 8);
+    frameHeader += char(frameSize);
+    frameHeader += QByteArray(2, '\0');
+
+    //! The tag size is syncsafe: seven bits per byte
+    quint32 const tagSize = frameHeader.size() + frame.size();
+    tag_ = "ID3";
+    tag_ += '\x03';
+    tag_ += '\0';
+    tag_ += '\0';
+    tag_ += char((tagSize >> 21) & 0x7f);
+    tag_ += char((tagSize >> 14) & 0x7f);
+    tag_ += char((tagSize >> 7) & 0x7f);
+    tag_ += char(tagSize & 0x7f);
+    tag_ += frameHeader;
+    tag_ += frame;
+}
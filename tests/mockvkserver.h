@@ -0,0 +1,83 @@
+#ifndef MOCKVKSERVER_H
+#define MOCKVKSERVER_H
+
+#include <QHash>
+#include <QStringList>
+#include <QTcpServer>
+#include <QUrl>
+
+#include <random>
+
+class QTcpSocket;
+
+//! Local stand-in for the VK API and its CDN: serves audio.* XML from a
+//! generated catalogue and range-capable synthetic MP3s with embedded
+//! cover art, with configurable latency and error rate
+class MockVkServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    explicit MockVkServer(QObject *parent = 0);
+
+    void setLatency(int milliseconds);
+    void setErrorRate(double rate);
+    void setTrackCount(int count);
+
+    //! Listen on QHostAddress::LocalHost; the url always points at 127.0.0.1
+    QUrl baseUrl() const;
+
+protected:
+    void incomingConnection(qintptr socketDescriptor);
+
+private slots:
+    void readRequests();
+    void writeBody();
+    void dropConnection();
+
+private:
+    struct Track
+    {
+        int id;
+        QString artist;
+        QString title;
+        int duration;
+    };
+
+    struct Connection
+    {
+        QByteArray buffer;
+        bool busy;
+        bool closeWhenDone;
+        qint64 offset;
+        qint64 end;
+
+        Connection() : busy(false), closeWhenDone(false), offset(0), end(0) {}
+    };
+
+    void processRequest(QTcpSocket *socket);
+    void pumpBody(QTcpSocket *socket);
+    void respond(QTcpSocket *socket, const QByteArray& path, const QByteArray& range);
+    void respondApi(QTcpSocket *socket, const QUrl& url);
+    void respondTrack(QTcpSocket *socket, int id, const QByteArray& range);
+    void writeHead(QTcpSocket *socket, int status, const QByteArray& reason,
+                   const QList<QPair<QByteArray, QByteArray> >& headers, qint64 length);
+    void finishResponse(QTcpSocket *socket);
+
+    QByteArray playlistXml(const QList<const Track*>& tracks);
+    qint64 trackSize(const Track& track) const;
+    int frameCount(const Track& track) const;
+    bool failRandomly();
+
+    void generateCatalogue(int count);
+    void generateTag();
+
+    QHash<QTcpSocket*, Connection> connections_;
+    QList<Track> tracks_;
+    QByteArray tag_;
+    int latency_;
+    double errorRate_;
+    std::mt19937 random_;
+};
+
+#endif // MOCKVKSERVER_H
@@ -0,0 +1,220 @@
+#include "soakdriver.h"
+#include "mediacomponent.h"
+#include "playerwidget.h"
+#include "resourcemonitor.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QTimer>
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+static const int SOAK_ACTION_PAUSE = 250;
+static const int SOAK_ACTION_TIMEOUT = 15000;
+
+//! Relative weights of Search, GenreSwitch and Skip
+static const int SOAK_ACTION_WEIGHTS[] = { 25, 15, 60 };
+
+static const char * const SOAK_SEARCH_WORDS[] =
+{
+    "love", "night", "city", "rain", "summer", "ночь", "город", "дождь", "лето", "звезда"
+};
+
+SoakDriver::SoakDriver(ApiComponent *api, MediaComponent *media, PlayerWidget *player, int actions, QObject *parent) :
+    QObject(parent), api_(api), media_(media), player_(player),
+    actionTimer_(new QTimer(this)), timeoutTimer_(new QTimer(this)), random_(std::random_device()()),
+    actions_(actions), done_(0), current_(ActionCount), started_(false),
+    initialResidentSetSize_(0), initialHandleCount_(0)
+{
+    Q_ASSERT(api);
+    Q_ASSERT(media);
+    Q_ASSERT(player);
+    Q_ASSERT(actions > 0);
+
+    std::fill(failures_, failures_ + ActionCount, 0);
+
+    actionTimer_->setSingleShot(true);
+    actionTimer_->setInterval(SOAK_ACTION_PAUSE);
+    timeoutTimer_->setSingleShot(true);
+    timeoutTimer_->setInterval(SOAK_ACTION_TIMEOUT);
+
+    connect(actionTimer_, &QTimer::timeout, this, &SoakDriver::nextAction);
+    connect(timeoutTimer_, &QTimer::timeout, this, &SoakDriver::timeoutAction);
+    //! Queued, so the player widget has already filled its model
+    connect(api_, &ApiComponent::playlistReceived, this, &SoakDriver::playlistReceived, Qt::QueuedConnection);
+    connect(media_->player(), &QMediaPlayer::mediaStatusChanged, this, &SoakDriver::mediaStatusChanged);
+}
+
+bool SoakDriver::isStarted() const
+{
+    return started_;
+}
+
+void SoakDriver::start()
+{
+    if (started_)
+        return;
+
+    started_ = true;
+    initialResidentSetSize_ = residentSetSize();
+    initialHandleCount_ = openHandleCount();
+    sessionTimer_.start();
+
+    std::printf("elapsed_ms,action,latency_ms,ok,rss_kb,handles,replies\n");
+    std::fflush(stdout);
+
+    player_->playRow(0);
+    actionTimer_->start();
+}
+
+void SoakDriver::nextAction()
+{
+    if (done_ >= actions_)
+    {
+        finish();
+        return;
+    }
+
+    std::discrete_distribution<int> actionDistribution(SOAK_ACTION_WEIGHTS, SOAK_ACTION_WEIGHTS + ActionCount);
+    current_ = actionDistribution(random_);
+    latencyTimer_.start();
+    timeoutTimer_->start();
+
+    switch (current_) {
+    case Search:
+    {
+        std::uniform_int_distribution<int> word(0, sizeof(SOAK_SEARCH_WORDS) / sizeof(SOAK_SEARCH_WORDS[0]) - 1);
+        ApiComponent::SearchQuery query;
+        query.artist = false;
+        query.text = QString::fromUtf8(SOAK_SEARCH_WORDS[word(random_)]);
+        api_->requestPlaylistBySearchQuery(query);
+        break;
+    }
+    case GenreSwitch:
+    {
+        QList<QString> const genres = api_->genres().keys();
+        std::uniform_int_distribution<int> genre(0, genres.size() - 1);
+        api_->requestPopularPlaylistByGenre(genres.at(genre(random_)));
+        break;
+    }
+    default:
+        media_->next();
+        break;
+    }
+}
+
+void SoakDriver::playlistReceived()
+{
+    if (current_ != Search && current_ != GenreSwitch)
+        return;
+
+    complete(true);
+    player_->playRow(0);
+}
+
+void SoakDriver::mediaStatusChanged(QMediaPlayer::MediaStatus status)
+{
+    if (current_ != Skip)
+        return;
+
+    if (status == QMediaPlayer::BufferedMedia)
+        complete(true);
+    else if (status == QMediaPlayer::InvalidMedia)
+        complete(false);
+}
+
+void SoakDriver::timeoutAction()
+{
+    complete(false);
+}
+
+void SoakDriver::complete(bool successfully)
+{
+    if (current_ == ActionCount)
+        return;
+
+    timeoutTimer_->stop();
+
+    qint64 const latency = latencyTimer_.elapsed();
+    if (successfully)
+        latencies_[current_].append(latency);
+    else
+        ++failures_[current_];
+
+    std::printf("%lld,%s,%lld,%d,%lld,%d,%lld\n", static_cast<long long>(sessionTimer_.elapsed()),
+                qPrintable(actionName(current_)), static_cast<long long>(latency), successfully ? 1 : 0,
+                static_cast<long long>(residentSetSize()), openHandleCount(),
+                static_cast<long long>(ResourceMonitor::snapshot().count[ResourceMonitor::NetworkReplies]));
+    std::fflush(stdout);
+
+    current_ = ActionCount;
+    ++done_;
+    actionTimer_->start();
+}
+
+void SoakDriver::finish()
+{
+    for (int action = 0; action < ActionCount; ++action)
+    {
+        QVector<qint64> latencies = latencies_[action];
+        std::sort(latencies.begin(), latencies.end());
+
+        qint64 const median = latencies.isEmpty() ? 0 : latencies.at(latencies.size() / 2);
+        qint64 const p95 = latencies.isEmpty() ? 0 : latencies.at(latencies.size() * 95 / 100);
+        qint64 const maximum = latencies.isEmpty() ? 0 : latencies.last();
+
+        std::fprintf(stderr, "soak: %s count=%d failed=%d p50=%lldms p95=%lldms max=%lldms\n",
+                     qPrintable(actionName(action)), latencies.size(), failures_[action],
+                     static_cast<long long>(median), static_cast<long long>(p95), static_cast<long long>(maximum));
+    }
+
+    std::fprintf(stderr, "soak: rss %lld -> %lld KB, handles %d -> %d\n%s\n",
+                 static_cast<long long>(initialResidentSetSize_), static_cast<long long>(residentSetSize()),
+                 initialHandleCount_, openHandleCount(), qPrintable(ResourceMonitor::report()));
+
+    QCoreApplication::exit(0);
+}
+
+QString SoakDriver::actionName(int action)
+{
+    switch (action) {
+    case Search:
+        return "search";
+    case GenreSwitch:
+        return "genre";
+    case Skip:
+        return "skip";
+    default:
+        return QString();
+    }
+}
+
+qint64 SoakDriver::residentSetSize()
+{
+#ifdef Q_OS_LINUX
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly))
+        return -1;
+
+    //! statm: size resident shared ..., in pages
+    QList<QByteArray> const fields = statm.readAll().split(' ');
+    return fields.value(1).toLongLong() * sysconf(_SC_PAGESIZE) / 1024;
+#else
+    return -1;
+#endif
+}
+
+int SoakDriver::openHandleCount()
+{
+#ifdef Q_OS_LINUX
+    return QDir("/proc/self/fd").entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::System).size();
+#else
+    return -1;
+#endif
+}
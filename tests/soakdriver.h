@@ -0,0 +1,73 @@
+#ifndef SOAKDRIVER_H
+#define SOAKDRIVER_H
+
+#include "apicomponent.h"
+
+#include <QElapsedTimer>
+#include <QMediaPlayer>
+#include <QObject>
+#include <QVector>
+
+#include <random>
+
+class MediaComponent;
+class PlayerWidget;
+class QTimer;
+
+//! Scripted session of searches, genre switches and track skips; every
+//! action is logged as a CSV line with its latency, resident memory and
+//! open handle count, and a latency summary is printed at the end
+class SoakDriver : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Action
+    {
+        Search,
+        GenreSwitch,
+        Skip,
+        ActionCount
+    };
+
+    explicit SoakDriver(ApiComponent *api, MediaComponent *media, PlayerWidget *player, int actions, QObject *parent = 0);
+
+    bool isStarted() const;
+
+public slots:
+    void start();
+
+private slots:
+    void nextAction();
+    void playlistReceived();
+    void mediaStatusChanged(QMediaPlayer::MediaStatus status);
+    void timeoutAction();
+
+private:
+    void complete(bool successfully);
+    void finish();
+
+    static QString actionName(int action);
+    static qint64 residentSetSize();
+    static int openHandleCount();
+
+    ApiComponent *api_;
+    MediaComponent *media_;
+    PlayerWidget *player_;
+    QTimer *actionTimer_;
+    QTimer *timeoutTimer_;
+    QElapsedTimer sessionTimer_;
+    QElapsedTimer latencyTimer_;
+    std::mt19937 random_;
+
+    int actions_;
+    int done_;
+    int current_;
+    bool started_;
+    qint64 initialResidentSetSize_;
+    int initialHandleCount_;
+    QVector<qint64> latencies_[ActionCount];
+    int failures_[ActionCount];
+};
+
+#endif // SOAKDRIVER_H
@@ -0,0 +1,22 @@
+# Development tools that do not ship with flow: the mock VK server, the
+# soak driver, the leak check and the benchmarks, built against the
+# application sources. The equalizer lives here until MediaComponent has a
+# decoder-driven output path it can process.
+
+include(../flow.pri)
+
+TARGET = flowtest
+TEMPLATE = app
+
+SOURCES += main.cpp \
+    mockvkserver.cpp \
+    soakdriver.cpp \
+    benchmarks.cpp \
+    leakcheck.cpp \
+    equalizer.cpp
+
+HEADERS  += mockvkserver.h \
+    soakdriver.h \
+    benchmarks.h \
+    leakcheck.h \
+    equalizer.h
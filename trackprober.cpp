@@ -0,0 +1,241 @@
+#include "trackprober.h"
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QSet>
+
+static const int DEFAULT_MAX_CONCURRENCY = 4;
+static const int PROBE_CHUNK_SIZE = 4096;
+static const int ID3_HEADER_SIZE = 10;
+static const int ID3_FOOTER_FLAG = 0x10;
+static const int MPEG_HEADER_SIZE = 4;
+
+//! kbps by [version 1 or 2][layer I, II, III][bitrate index]
+static const int MPEG_BITRATES[2][3][15] =
+{
+    {
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 }
+    },
+    {
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }
+    }
+};
+
+TrackProber::TrackProber(QNetworkAccessManager *networkManager, QObject *parent) : QObject(parent),
+    networkManager_(networkManager), maxConcurrency_(DEFAULT_MAX_CONCURRENCY)
+{
+    Q_ASSERT(networkManager);
+}
+
+void TrackProber::setMaxConcurrency(int maxConcurrency)
+{
+    Q_ASSERT(maxConcurrency > 0);
+
+    maxConcurrency_ = maxConcurrency;
+    pump();
+}
+
+void TrackProber::probe(const QList<TrackProber::Request> &requests)
+{
+    QSet<QUrl> wanted;
+    foreach (const Request& request, requests)
+        wanted.insert(request.url);
+
+    QSet<QUrl> known;
+
+    for (QList<Request>::iterator it = pending_.begin(); it != pending_.end();)
+    {
+        if (wanted.contains(it->url))
+        {
+            known.insert(it->url);
+            ++it;
+        }
+        else
+            it = pending_.erase(it);
+    }
+
+    //! Rows scrolled out of view are not worth their bandwidth anymore
+    foreach (QNetworkReply *reply, active_.keys())
+    {
+        if (wanted.contains(active_.value(reply).request.url))
+            known.insert(active_.value(reply).request.url);
+        else
+            release(reply);
+    }
+
+    foreach (const Request& request, requests)
+    {
+        if (!known.contains(request.url))
+        {
+            pending_.append(request);
+            known.insert(request.url);
+        }
+    }
+
+    pump();
+}
+
+void TrackProber::cancelAll()
+{
+    pending_.clear();
+
+    foreach (QNetworkReply *reply, active_.keys())
+        release(reply);
+}
+
+void TrackProber::readProbeData()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply || !active_.contains(reply))
+        return;
+
+    Probe& probe = active_[reply];
+    probe.data += reply->read(PROBE_CHUNK_SIZE - probe.data.size());
+
+    //! Servers ignoring the range would send the whole file
+    if (probe.data.size() >= PROBE_CHUNK_SIZE)
+        complete(reply);
+}
+
+void TrackProber::finishProbe()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply || !active_.contains(reply))
+        return;
+
+    Probe& probe = active_[reply];
+    probe.data += reply->read(PROBE_CHUNK_SIZE - probe.data.size());
+
+    complete(reply);
+}
+
+void TrackProber::pump()
+{
+    while (active_.size() < maxConcurrency_ && !pending_.isEmpty())
+    {
+        Probe probe;
+        probe.request = pending_.takeFirst();
+        probe.offset = 0;
+        probe.size = 0;
+        probe.tagSize = 0;
+        start(probe);
+    }
+}
+
+void TrackProber::start(const Probe &probe)
+{
+    QNetworkRequest networkRequest(probe.request.url);
+    networkRequest.setPriority(QNetworkRequest::LowPriority);
+    networkRequest.setRawHeader("Range", "bytes=" + QByteArray::number(probe.offset) + "-" +
+                                QByteArray::number(probe.offset + PROBE_CHUNK_SIZE - 1));
+
+    QNetworkReply *reply = networkManager_->get(networkRequest);
+    active_.insert(reply, probe);
+
+    connect(reply, &QNetworkReply::readyRead, this, &TrackProber::readProbeData);
+    connect(reply, &QNetworkReply::finished, this, &TrackProber::finishProbe);
+}
+
+void TrackProber::complete(QNetworkReply *reply)
+{
+    Probe probe = active_.value(reply);
+    bool const failed = reply->error() != QNetworkReply::NoError && probe.data.isEmpty();
+
+    if (probe.size == 0)
+        probe.size = totalSize(reply);
+
+    release(reply);
+
+    if (failed)
+    {
+        emit probed(probe.request.row, probe.request.url, 0, -1);
+        pump();
+        return;
+    }
+
+    QByteArray const& data = probe.data;
+
+    if (probe.offset == 0 && data.startsWith("ID3") && data.size() >= ID3_HEADER_SIZE)
+    {
+        //! Syncsafe size excluding the header, plus an optional footer
+        probe.tagSize = ((data.at(6) & 0x7f) << 21) | ((data.at(7) & 0x7f) << 14) |
+                        ((data.at(8) & 0x7f) << 7) | (data.at(9) & 0x7f);
+        probe.tagSize += ID3_HEADER_SIZE;
+        if (data.at(5) & ID3_FOOTER_FLAG)
+            probe.tagSize += ID3_HEADER_SIZE;
+
+        if (probe.tagSize + MPEG_HEADER_SIZE > data.size() && (probe.size <= 0 || probe.tagSize < probe.size))
+        {
+            probe.offset = probe.tagSize;
+            probe.data.clear();
+            start(probe);
+            return;
+        }
+    }
+
+    int frameOffset = -1;
+    int bitrate = parseFrameBitrate(data, qMax<qint64>(0, probe.tagSize - probe.offset), frameOffset);
+
+    if (bitrate > 0 && hasVbrHeader(data, frameOffset) && probe.size > 0 && probe.request.duration > 0)
+        bitrate = int((probe.size - probe.tagSize) * 8 / probe.request.duration / 1000);
+
+    emit probed(probe.request.row, probe.request.url, bitrate, probe.size > 0 ? probe.size : -1);
+    pump();
+}
+
+void TrackProber::release(QNetworkReply *reply)
+{
+    active_.remove(reply);
+    disconnect(reply, 0, this, 0);
+    reply->abort();
+    reply->deleteLater();
+}
+
+qint64 TrackProber::totalSize(QNetworkReply *reply)
+{
+    QByteArray const contentRange = reply->rawHeader("Content-Range");
+    int const separator = contentRange.lastIndexOf('/');
+    if (separator >= 0)
+        return contentRange.mid(separator + 1).toLongLong();
+
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 200)
+        return reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+
+    return 0;
+}
+
+int TrackProber::parseFrameBitrate(const QByteArray &data, int from, int &frameOffset)
+{
+    const uchar *bytes = reinterpret_cast<const uchar*>(data.constData());
+
+    for (int i = from; i + MPEG_HEADER_SIZE <= data.size(); ++i)
+    {
+        if (bytes[i] != 0xff || (bytes[i + 1] & 0xe0) != 0xe0)
+            continue;
+
+        int const version = (bytes[i + 1] >> 3) & 0x03;  //! 0 - 2.5, 1 - reserved, 2 - 2, 3 - 1
+        int const layer = (bytes[i + 1] >> 1) & 0x03;    //! 0 - reserved, 1 - III, 2 - II, 3 - I
+        int const bitrateIndex = bytes[i + 2] >> 4;
+        int const sampleRateIndex = (bytes[i + 2] >> 2) & 0x03;
+
+        if (version == 1 || layer == 0 || bitrateIndex == 0 || bitrateIndex == 15 || sampleRateIndex == 3)
+            continue;
+
+        frameOffset = i;
+        return MPEG_BITRATES[version == 3 ? 0 : 1][3 - layer][bitrateIndex];
+    }
+
+    return 0;
+}
+
+bool TrackProber::hasVbrHeader(const QByteArray &data, int frameOffset)
+{
+    //! Xing/Info sits after the side information, VBRI at a fixed offset;
+    //! a small window covers every channel mode and MPEG version
+    QByteArray const head = data.mid(frameOffset + MPEG_HEADER_SIZE, 64);
+    return head.contains("Xing") || head.contains("Info") || head.contains("VBRI");
+}
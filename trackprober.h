@@ -0,0 +1,69 @@
+#ifndef TRACKPROBER_H
+#define TRACKPROBER_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+//! Reads only the head of remote tracks (ID3 header and first MPEG frame)
+//! through HTTP ranges on a bounded pool of connections
+class TrackProber : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Request
+    {
+        int row;
+        QUrl url;
+        int duration;
+    };
+
+    explicit TrackProber(QNetworkAccessManager *networkManager, QObject *parent = 0);
+
+    void setMaxConcurrency(int maxConcurrency);
+
+signals:
+    //! size is -1 when the track could not be probed
+    void probed(int row, const QUrl& url, int bitrate, qint64 size);
+
+public slots:
+    void probe(const QList<TrackProber::Request>& requests);
+    void cancelAll();
+
+private slots:
+    void readProbeData();
+    void finishProbe();
+
+private:
+    struct Probe
+    {
+        Request request;
+        QByteArray data;
+        qint64 offset;
+        qint64 size;
+        qint64 tagSize;
+    };
+
+    void pump();
+    void start(const Probe& probe);
+    void complete(QNetworkReply *reply);
+    void release(QNetworkReply *reply);
+
+    static qint64 totalSize(QNetworkReply *reply);
+    static int parseFrameBitrate(const QByteArray& data, int from, int& frameOffset);
+    static bool hasVbrHeader(const QByteArray& data, int frameOffset);
+
+    QNetworkAccessManager *networkManager_;
+    QList<Request> pending_;
+    QHash<QNetworkReply*, Probe> active_;
+    int maxConcurrency_;
+};
+
+Q_DECLARE_METATYPE(TrackProber::Request)
+
+#endif // TRACKPROBER_H
@@ -0,0 +1,126 @@
+#include "urlresolver.h"
+#include "apicomponent.h"
+#include "mediacomponent.h"
+
+#include <QDateTime>
+#include <QTimer>
+
+static const int DEFAULT_LOOKAHEAD = 5;
+static const qint64 DEFAULT_MAX_AGE = 30 * 60 * 1000;
+static const int CHECK_INTERVAL = 60 * 1000;
+static const qint64 RESOLVE_TIMEOUT = 30 * 1000;
+
+UrlResolver::UrlResolver(ApiComponent *api, MediaComponent *media, QObject *parent) : QObject(parent),
+    api_(api), media_(media), checkTimer_(new QTimer(this)), lookahead_(DEFAULT_LOOKAHEAD), maxAge_(DEFAULT_MAX_AGE)
+{
+    Q_ASSERT(api);
+    Q_ASSERT(media);
+
+    clock_.start();
+
+    connect(media_->model(), &PlaylistModel::modelReset, this, &UrlResolver::forgetRetries);
+    connect(media_->playlist(), &QMediaPlaylist::currentIndexChanged, this, &UrlResolver::resolveUpcoming);
+    connect(media_->player(), static_cast<void (QMediaPlayer::*)(QMediaPlayer::Error)>(&QMediaPlayer::error),
+            this, &UrlResolver::resolveFailed);
+    connect(media_->downloads(), &DownloadManager::urlsExpired, this, &UrlResolver::resolveDownloads);
+    connect(api_, &ApiComponent::tracksResolved, this, &UrlResolver::applyResolved);
+
+    //! A long track can outlive the urls of the ones queued after it
+    checkTimer_->setInterval(CHECK_INTERVAL);
+    connect(checkTimer_, &QTimer::timeout, this, &UrlResolver::resolveUpcoming);
+    checkTimer_->start();
+}
+
+void UrlResolver::setLookahead(int count)
+{
+    Q_ASSERT(count > 0);
+    lookahead_ = count;
+}
+
+void UrlResolver::setMaxAge(qint64 maxAge)
+{
+    Q_ASSERT(maxAge > 0);
+    maxAge_ = maxAge;
+}
+
+void UrlResolver::forgetRetries()
+{
+    //! A new queue gets one restart per failing track again
+    retried_.clear();
+}
+
+void UrlResolver::resolveUpcoming()
+{
+    PlaylistModel const * const model = media_->model();
+    qint64 const now = QDateTime::currentMSecsSinceEpoch();
+    QStringList ids;
+
+    foreach (int index, media_->upcomingIndexes(lookahead_))
+    {
+        if (index < 0 || index >= model->rowCount() || media_->url(index).isLocalFile())
+            continue;
+
+        PlaylistModel::Track const& track = model->track(index);
+        if (track.id.isEmpty() || isPending(track.id) || ids.contains(track.id))
+            continue;
+
+        if (now - track.signedAt >= maxAge_)
+            ids.append(track.id);
+    }
+
+    foreach (const QString& id, ids)
+        requestedAt_.insert(id, clock_.elapsed());
+
+    api_->requestTracksById(ids);
+}
+
+void UrlResolver::resolveFailed(QMediaPlayer::Error error)
+{
+    if (error != QMediaPlayer::ResourceError && error != QMediaPlayer::NetworkError &&
+            error != QMediaPlayer::AccessDeniedError)
+        return;
+
+    int const current = media_->playlist()->currentIndex();
+    if (current < 0 || current >= media_->model()->rowCount() || media_->url(current).isLocalFile())
+        return;
+
+    QString const id = media_->model()->track(current).id;
+    if (id.isEmpty() || retried_.contains(id) || isPending(id))
+        return;
+
+    retried_.insert(id);
+    requestedAt_.insert(id, clock_.elapsed());
+    api_->requestTracksById(QStringList() << id);
+}
+
+void UrlResolver::resolveDownloads(const QStringList &ids)
+{
+    qint64 const now = clock_.elapsed();
+    QStringList requested;
+
+    foreach (const QString& id, ids)
+    {
+        if (isPending(id))
+            continue;
+
+        requestedAt_.insert(id, now);
+        requested.append(id);
+    }
+
+    api_->requestTracksById(requested);
+}
+
+void UrlResolver::applyResolved(const PlaylistModel::Tracks &tracks)
+{
+    foreach (const PlaylistModel::Track& track, tracks)
+        requestedAt_.remove(track.id);
+
+    media_->refreshUrls(tracks);
+    media_->downloads()->refreshUrls(tracks);
+}
+
+bool UrlResolver::isPending(const QString &id) const
+{
+    QHash<QString, qint64>::const_iterator const requested = requestedAt_.constFind(id);
+    return requested != requestedAt_.constEnd() && clock_.elapsed() - *requested < RESOLVE_TIMEOUT;
+}
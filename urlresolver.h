@@ -0,0 +1,51 @@
+#ifndef URLRESOLVER_H
+#define URLRESOLVER_H
+
+#include "playlistmodel.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMediaPlayer>
+#include <QObject>
+#include <QSet>
+
+class ApiComponent;
+class MediaComponent;
+class QTimer;
+
+//! Keeps the signed stream urls of the queue fresh just in time: urls of
+//! the next few tracks that are older than the maximum age are re-signed
+//! in one audio.getById batch, and a track that fails to open is
+//! re-resolved and restarted once. Offline downloads that fail get fresh
+//! urls for their retries the same way.
+class UrlResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UrlResolver(ApiComponent *api, MediaComponent *media, QObject *parent = 0);
+
+    void setLookahead(int count);
+    void setMaxAge(qint64 maxAge);
+
+private slots:
+    void forgetRetries();
+    void resolveUpcoming();
+    void resolveFailed(QMediaPlayer::Error error);
+    void resolveDownloads(const QStringList& ids);
+    void applyResolved(const PlaylistModel::Tracks& tracks);
+
+private:
+    bool isPending(const QString& id) const;
+
+    ApiComponent *api_;
+    MediaComponent *media_;
+    QTimer *checkTimer_;
+    QElapsedTimer clock_;
+    QHash<QString, qint64> requestedAt_;
+    QSet<QString> retried_;
+    int lookahead_;
+    qint64 maxAge_;
+};
+
+#endif // URLRESOLVER_H
@@ -0,0 +1,314 @@
+#include "waveformcomponent.h"
+#include "playlistmodel.h"
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const int WAVEFORM_CACHE_SIZE = 64;
+static const int WAVEFORM_PUBLISH_INTERVAL = 100;
+static const int WAVEFORM_DECODE_RATE = 11025;
+static const qint64 WAVEFORM_READ_BUFFER_SIZE = 256 * 1024;
+
+//! Widens [lo, hi] with the extremes of count float samples
+static void reduceFloatPeaks(const float *samples, int count, float& lo, float& hi)
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    if (count >= 8)
+    {
+        __m128 vlo = _mm_set1_ps(lo);
+        __m128 vhi = _mm_set1_ps(hi);
+
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128 const a = _mm_loadu_ps(samples + i);
+            __m128 const b = _mm_loadu_ps(samples + i + 4);
+            vlo = _mm_min_ps(vlo, _mm_min_ps(a, b));
+            vhi = _mm_max_ps(vhi, _mm_max_ps(a, b));
+        }
+
+        float l[4], h[4];
+        _mm_storeu_ps(l, vlo);
+        _mm_storeu_ps(h, vhi);
+        for (int j = 0; j < 4; ++j)
+        {
+            lo = qMin(lo, l[j]);
+            hi = qMax(hi, h[j]);
+        }
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        lo = qMin(lo, samples[i]);
+        hi = qMax(hi, samples[i]);
+    }
+}
+
+//! Same as reduceFloatPeaks for signed 16-bit samples, normalized to [-1, 1]
+static void reduceInt16Peaks(const qint16 *samples, int count, float& lo, float& hi)
+{
+    qint16 slo = qint16(qBound(-32768.0f, lo * 32768.0f, 32767.0f));
+    qint16 shi = qint16(qBound(-32768.0f, hi * 32768.0f, 32767.0f));
+    int i = 0;
+
+#ifdef __SSE2__
+    if (count >= 16)
+    {
+        __m128i vlo = _mm_set1_epi16(slo);
+        __m128i vhi = _mm_set1_epi16(shi);
+
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i const a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+            __m128i const b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i + 8));
+            vlo = _mm_min_epi16(vlo, _mm_min_epi16(a, b));
+            vhi = _mm_max_epi16(vhi, _mm_max_epi16(a, b));
+        }
+
+        qint16 l[8], h[8];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(l), vlo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(h), vhi);
+        for (int j = 0; j < 8; ++j)
+        {
+            slo = qMin(slo, l[j]);
+            shi = qMax(shi, h[j]);
+        }
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        slo = qMin(slo, samples[i]);
+        shi = qMax(shi, samples[i]);
+    }
+
+    lo = slo / 32768.0f;
+    hi = shi / 32768.0f;
+}
+
+WaveformComponent::WaveformComponent(QNetworkAccessManager *networkManager, QObject *parent) : QObject(parent),
+    decoder_(new QAudioDecoder(this)), networkManager_(networkManager), reply_(0),
+    cache_(WAVEFORM_CACHE_SIZE), duration_(0), throttled_(false)
+{
+    Q_ASSERT(networkManager);
+
+    qRegisterMetaType<WaveformComponent::Peaks>();
+
+    QAudioFormat format;
+    format.setCodec("audio/pcm");
+    format.setSampleRate(WAVEFORM_DECODE_RATE);
+    format.setChannelCount(1);
+    format.setSampleSize(32);
+    format.setSampleType(QAudioFormat::Float);
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    decoder_->setAudioFormat(format);
+
+    connect(decoder_, &QAudioDecoder::bufferReady, this, &WaveformComponent::readBuffer);
+    connect(decoder_, &QAudioDecoder::finished, this, &WaveformComponent::finishAnalysis);
+    connect(decoder_, static_cast<void (QAudioDecoder::*)(QAudioDecoder::Error)>(&QAudioDecoder::error),
+            this, &WaveformComponent::failAnalysis);
+}
+
+WaveformComponent::~WaveformComponent()
+{
+}
+
+void WaveformComponent::analyze(const QUrl &url, qint64 duration)
+{
+    QString const key = cacheKey(url);
+    if (key == currentKey_)
+    {
+        duration_ = duration;
+        return;
+    }
+
+    reset();
+    currentKey_ = key;
+
+    if (Peaks *cached = cache_.object(key))
+    {
+        emit peaksUpdated(*cached);
+        return;
+    }
+
+    duration_ = duration;
+    currentUrl_ = url;
+
+    if (throttled_)
+    {
+        current_.minimum.fill(0.0f, BUCKET_COUNT);
+        current_.maximum.fill(0.0f, BUCKET_COUNT);
+        emit peaksUpdated(current_);
+        return;
+    }
+
+    startDecoding();
+}
+
+void WaveformComponent::stop()
+{
+    reset();
+    emit peaksUpdated(current_);
+}
+
+void WaveformComponent::setThrottled(bool throttled)
+{
+    if (throttled_ == throttled)
+        return;
+
+    throttled_ = throttled;
+
+    if (throttled_ && reply_)
+        stopDecoding();
+    else if (!throttled_ && !reply_ && !currentUrl_.isEmpty())
+        startDecoding();
+}
+
+void WaveformComponent::readBuffer()
+{
+    while (decoder_->bufferAvailable())
+        reduceBuffer(decoder_->read());
+
+    publishPeaks(false);
+}
+
+void WaveformComponent::finishAnalysis()
+{
+    //! A decoder stopped by throttling has nothing complete to keep
+    if (!reply_)
+        return;
+
+    currentUrl_.clear();
+    publishPeaks(true);
+
+    if (!currentKey_.isEmpty() && !current_.isEmpty())
+        cache_.insert(currentKey_, new Peaks(current_));
+}
+
+void WaveformComponent::failAnalysis()
+{
+    if (!reply_)
+        return;
+
+    //! Forget the key too so the next analyze() of this track starts over
+    //! instead of keeping the partial envelope forever
+    stopDecoding();
+    currentKey_.clear();
+    currentUrl_.clear();
+}
+
+void WaveformComponent::reset()
+{
+    stopDecoding();
+
+    currentKey_.clear();
+    currentUrl_.clear();
+    current_ = Peaks();
+    duration_ = 0;
+}
+
+void WaveformComponent::startDecoding()
+{
+    Q_ASSERT(!reply_);
+
+    current_ = Peaks();
+    current_.minimum.fill(0.0f, BUCKET_COUNT);
+    current_.maximum.fill(0.0f, BUCKET_COUNT);
+    emit peaksUpdated(current_);
+
+    //! Decode straight from the network stream; the bounded read buffer
+    //! applies backpressure so memory does not grow with the track length.
+    //! The playing stream and its prefetches go first.
+    QNetworkRequest request(currentUrl_);
+    request.setPriority(QNetworkRequest::LowPriority);
+    reply_ = networkManager_->get(request);
+    reply_->setReadBufferSize(WAVEFORM_READ_BUFFER_SIZE);
+    connect(reply_, static_cast<void (QNetworkReply::*)(QNetworkReply::NetworkError)>(&QNetworkReply::error),
+            this, &WaveformComponent::failAnalysis);
+    decoder_->setSourceDevice(reply_);
+    decoder_->start();
+    publishTimer_.start();
+}
+
+void WaveformComponent::stopDecoding()
+{
+    decoder_->stop();
+
+    if (reply_)
+    {
+        reply_->disconnect(this);
+        reply_->abort();
+        reply_->deleteLater();
+        reply_ = 0;
+    }
+}
+
+void WaveformComponent::reduceBuffer(const QAudioBuffer &buffer)
+{
+    QAudioFormat const format = buffer.format();
+    int const channels = format.channelCount();
+    int const sampleRate = format.sampleRate();
+    int const frames = buffer.frameCount();
+    qint64 const duration = duration_ * 1000;
+
+    if (duration <= 0 || sampleRate <= 0 || channels <= 0)
+        return;
+
+    bool const isFloat = format.sampleType() == QAudioFormat::Float && format.sampleSize() == 32;
+    bool const isInt16 = format.sampleType() == QAudioFormat::SignedInt && format.sampleSize() == 16;
+    if (!isFloat && !isInt16)
+        return;
+
+    qint64 const start = buffer.startTime();
+    int frame = 0;
+
+    while (frame < frames)
+    {
+        qint64 const time = start + qint64(frame) * 1000000 / sampleRate;
+        int const bucket = qMin<qint64>(time * BUCKET_COUNT / duration, BUCKET_COUNT - 1);
+
+        int endFrame = frames;
+        if (bucket < BUCKET_COUNT - 1)
+        {
+            qint64 const bucketEnd = (qint64(bucket) + 1) * duration / BUCKET_COUNT;
+            qint64 const bucketEndFrame = ((bucketEnd - start) * sampleRate + 999999) / 1000000;
+            endFrame = qBound<qint64>(frame + 1, bucketEndFrame, frames);
+        }
+
+        float lo = current_.minimum[bucket];
+        float hi = current_.maximum[bucket];
+        int const offset = frame * channels;
+        int const count = (endFrame - frame) * channels;
+
+        if (isFloat)
+            reduceFloatPeaks(buffer.constData<float>() + offset, count, lo, hi);
+        else
+            reduceInt16Peaks(buffer.constData<qint16>() + offset, count, lo, hi);
+
+        current_.minimum[bucket] = lo;
+        current_.maximum[bucket] = hi;
+        current_.filled = qMax(current_.filled, bucket + 1);
+
+        frame = endFrame;
+    }
+}
+
+void WaveformComponent::publishPeaks(bool force)
+{
+    if (force || publishTimer_.elapsed() >= WAVEFORM_PUBLISH_INTERVAL)
+    {
+        emit peaksUpdated(current_);
+        publishTimer_.restart();
+    }
+}
+
+QString WaveformComponent::cacheKey(const QUrl &url)
+{
+    return PlaylistModel::streamKey(url);
+}
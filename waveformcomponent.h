@@ -0,0 +1,75 @@
+#ifndef WAVEFORMCOMPONENT_H
+#define WAVEFORMCOMPONENT_H
+
+#include <QAudioBuffer>
+#include <QAudioDecoder>
+#include <QCache>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QUrl>
+#include <QVector>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+class WaveformComponent : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Fixed-size min/max envelope of a track, independent of its length
+    struct Peaks
+    {
+        QVector<float> minimum;
+        QVector<float> maximum;
+        int filled;
+
+        Peaks() : filled(0) {}
+        bool isEmpty() const { return filled == 0; }
+    };
+
+    static const int BUCKET_COUNT = 1024;
+
+    explicit WaveformComponent(QNetworkAccessManager *networkManager, QObject *parent = 0);
+    ~WaveformComponent();
+
+signals:
+    void peaksUpdated(const WaveformComponent::Peaks& peaks);
+
+public slots:
+    void analyze(const QUrl& url, qint64 duration);
+    void stop();
+    //! While throttled the analysis gives the link to the playing stream: a
+    //! pending one waits and a running one is dropped and started over later
+    void setThrottled(bool throttled);
+
+private slots:
+    void readBuffer();
+    void finishAnalysis();
+    void failAnalysis();
+
+private:
+    void reset();
+    void startDecoding();
+    void stopDecoding();
+    void reduceBuffer(const QAudioBuffer& buffer);
+    void publishPeaks(bool force);
+
+    static QString cacheKey(const QUrl& url);
+
+    QAudioDecoder *decoder_;
+    QNetworkAccessManager *networkManager_;
+    QNetworkReply *reply_;
+    QCache<QString, Peaks> cache_;
+    QString currentKey_;
+    //! Source of an analysis that has not finished yet
+    QUrl currentUrl_;
+    Peaks current_;
+    qint64 duration_;
+    bool throttled_;
+    QElapsedTimer publishTimer_;
+};
+
+Q_DECLARE_METATYPE(WaveformComponent::Peaks)
+
+#endif // WAVEFORMCOMPONENT_H